@@ -0,0 +1,16 @@
+$input a_position, a_texcoord0, a_texcoord1
+$output v_texcoord0
+
+#include "bgfx_shader.sh"
+
+// x: scroll position at the receptors, y: pixels per unit of it
+uniform vec4 u_scroll;
+
+void main()
+{
+	vec2 pos = a_position.xy;
+	pos.y -= (a_texcoord1.x - u_scroll.x) * u_scroll.y;
+
+	v_texcoord0 = a_texcoord0;
+	gl_Position = mul(u_modelViewProj, vec4(pos, 0.0, 1.0));
+}
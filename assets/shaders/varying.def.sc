@@ -2,3 +2,4 @@ vec2 v_texcoord0 : TEXCOORD0 = vec2(0.5, 0.5);
 
 vec3 a_position  : POSITION;
 vec2 a_texcoord0 : TEXCOORD0;
+vec2 a_texcoord1 : TEXCOORD1;
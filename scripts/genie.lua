@@ -2,6 +2,11 @@ BASE_DIR   = path.getabsolute("..")
 EXTERN_DIR = path.join(BASE_DIR, "extern")
 
 dofile "toolchain.lua"
+
+newoption {
+	trigger = "alloc-trace",
+	description = "Record every allocation the game makes to alloc.trace, for allocbench"
+}
 if _ACTION == "gmake" and _OPTIONS["gcc"] == nil then
 	if os.is "windows" then
 		_OPTIONS["gcc"] = "mingw-gcc"
@@ -82,6 +87,13 @@ project "Varibeat" do
 		"LODEPNG_NO_COMPILE_ALLOCATORS"
 	}
 
+	-- only the game; allocbench tracing itself would measure the lock.
+	if _OPTIONS["alloc-trace"] then
+		defines {
+			"VBEAT_ALLOC_TRACE=1"
+		}
+	end
+
 	configuration {"Debug"}
 	defines {
 		"VBEAT_DEBUG"
@@ -97,6 +109,10 @@ project "Varibeat" do
 	links {
 		"dl"
 	}
+	-- so no-alloc scope reports get symbol names
+	linkoptions {
+		"-rdynamic"
+	}
 	configuration {"gmake"}
 	buildoptions {
 		"-fexceptions",
@@ -139,6 +155,132 @@ project "Varibeat" do
 	collect()
 end
 
+-- .sm/.ssc to .vbc. Only the chart code, no VFS or renderer.
+project "chartc" do
+	kind "ConsoleApp"
+	language "C++"
+	local VBEAT_DIR = path.join(BASE_DIR, "src")
+	local TOOL_DIR  = path.join(BASE_DIR, "tools/chartc")
+
+	defines {
+		"VBEAT_PROFILE=0"
+	}
+
+	configuration {"gmake"}
+	buildoptions {
+		"-std=c++11",
+		"-Wall",
+		"-Wextra"
+	}
+
+	configuration {"windows", "vs*"}
+	defines {
+		"_CRT_SECURE_NO_WARNINGS"
+	}
+
+	configuration {}
+	files {
+		path.join(TOOL_DIR, "**.cpp"),
+		path.join(VBEAT_DIR, "chart/chart.cpp"),
+		path.join(VBEAT_DIR, "chart/timing.cpp"),
+		path.join(VBEAT_DIR, "chart/sm.cpp"),
+		path.join(VBEAT_DIR, "chart/binary.cpp")
+	}
+	includedirs {
+		VBEAT_DIR
+	}
+end
+
+-- The headless tools: everything in src/ but main() and the renderer side.
+-- SDL is there for threads and timers and PhysFS for the VFS; nothing links
+-- bgfx, GL or X11, so they run on a machine without a display.
+local function headless_tool(name)
+	project(name)
+	kind "ConsoleApp"
+	language "C++"
+	local VBEAT_DIR = path.join(BASE_DIR, "src")
+	local TOOL_DIR  = path.join(BASE_DIR, "tools", name)
+
+	links {
+		"SDL2",
+		"PhysFS",
+	}
+
+	configuration {"Debug"}
+	defines {
+		"VBEAT_DEBUG"
+	}
+
+	configuration {"linux"}
+	links {
+		"pthread"
+	}
+
+	-- symbol names in the allocator's debug backtraces
+	configuration {"linux", "Debug"}
+	links {
+		"dl"
+	}
+	linkoptions {
+		"-rdynamic"
+	}
+
+	configuration {"gmake"}
+	buildoptions {
+		"-fexceptions",
+		"-std=c++11",
+		"-fno-strict-aliasing",
+		"-Wall",
+		"-Wextra"
+	}
+
+	configuration {}
+	files {
+		path.join(TOOL_DIR, "**.cpp"),
+		path.join(VBEAT_DIR, "**.cpp"),
+		path.join(VBEAT_DIR, "**.hpp")
+	}
+	excludes {
+		path.join(VBEAT_DIR, "vbeat.cpp"),
+		path.join(VBEAT_DIR, "graphics/**")
+	}
+	-- bgfx's headers still get included for types and flags, that's all.
+	includedirs {
+		VBEAT_DIR,
+		EXTERN_DIR,
+		path.join(EXTERN_DIR, "bgfx/include"),
+		path.join(BASE_DIR, "scripts/include"),
+		PHYSFS_DIR,
+		BX_DIR
+	}
+	if os.get() == "windows" then
+		links {
+			"psapi"
+		}
+	end
+	configuration {"windows", "vs*"}
+	defines {
+		"_CRT_SECURE_NO_WARNINGS",
+		"VBEAT_WINDOWS",
+	}
+	includedirs {
+		path.join(BX_DIR, "compat/msvc")
+	}
+	configuration {}
+end
+
+-- Chart metrics for the whole library.
+headless_tool "analyze"
+
+-- Scores replays against a chart, for checking submissions.
+headless_tool "verify"
+
+-- Replays an allocation trace against the pool and the CRT.
+headless_tool "allocbench"
+
+-- Checks for what doesn't need a window; bin/tests.
+headless_tool "tests"
+
 -- now that we've got everything, spit out a .clang_complete file.
 local f = io.open(path.join(BASE_DIR, ".clang_complete"), "w")
 for _, v in ipairs(includes) do
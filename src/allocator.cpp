@@ -0,0 +1,714 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <SDL2/SDL_atomic.h>
+
+#include "vbeat.hpp"
+#include "allocator.hpp"
+#include "hitch.hpp"
+
+#if VBEAT_ALLOC_GUARD
+#	if defined(VBEAT_WINDOWS)
+#		define WIN32_LEAN_AND_MEAN
+#		include <Windows.h>
+#	elif defined(__GLIBC__) || defined(__APPLE__)
+#		include <execinfo.h>
+#		include <unistd.h>
+#		define VBEAT_HAS_EXECINFO
+#	endif
+#endif
+
+using namespace vbeat;
+
+namespace {
+	const size_t header_size = pool_allocator_t::header_size;
+	const size_t max_small   = pool_allocator_t::max_small;
+	const int    num_classes = pool_allocator_t::num_classes;
+
+	const uint16_t large_class = 0xFFFF;
+	const size_t   slab_size   = 64 * 1024;
+
+	/* Sits right in front of every block we hand out. 16 bytes, so anything
+	 * following it keeps the alignment malloc would have given us. */
+	struct block_header_t {
+		uint16_t size_class;
+		uint8_t  tag;
+		uint8_t  unused;
+		uint32_t offset; // large blocks: distance back to what malloc returned
+		uint64_t size;   // requested size
+	};
+
+	// Free blocks reuse their own storage as the list link.
+	struct free_block_t {
+		free_block_t *next;
+	};
+
+	/* Classes are 16 bytes apart up to 128, then four steps per power of two
+	 * up to 4096. Sizes include the header. */
+	size_t class_size(int c) {
+		if (c < 7) {
+			return size_t(c + 2) * 16;
+		}
+		int k = c - 7;
+		int p = 7 + k / 4;
+		size_t step = size_t(1) << (p - 2);
+		return (size_t(1) << p) + size_t(k % 4 + 1) * step;
+	}
+
+	int size_to_class(size_t bytes) {
+		size_t n = bytes + header_size;
+		if (n <= 128) {
+			return n <= 32 ? 0 : int((n + 15) / 16) - 2;
+		}
+		int p = 7;
+		while ((size_t(1) << (p + 1)) < n) {
+			p++;
+		}
+		size_t step = size_t(1) << (p - 2);
+		size_t idx = (n - (size_t(1) << p) + step - 1) / step;
+		return 7 + (p - 7) * 4 + int(idx) - 1;
+	}
+
+	// How many blocks move between a thread and the shared list at once.
+	uint32_t batch_size(int c) {
+		size_t n = (16 * 1024) / class_size(c);
+		return n < 4 ? 4 : (n > 64 ? 64 : uint32_t(n));
+	}
+
+	struct thread_cache_t {
+		free_block_t *head[num_classes];
+		uint32_t count[num_classes];
+
+		// not handed to hitch yet, see publish_thread_counts.
+		uint32_t allocs;
+		uint32_t alloc_bytes;
+	};
+
+	struct central_list_t {
+		SDL_SpinLock lock;
+		free_block_t *head;
+	};
+
+	// Both zero initialized, so they're usable before any constructors run.
+	VBEAT_THREAD_LOCAL thread_cache_t t_cache;
+	central_list_t central[num_classes];
+
+#if VBEAT_HEAP_TRACKING
+	VBEAT_THREAD_LOCAL int t_tag;
+
+	struct tag_counters_t {
+		size_t live_bytes;
+		size_t live_count;
+		size_t frame_allocs;
+		size_t frame_bytes;
+		size_t last_allocs;
+		size_t last_bytes;
+		size_t high_water;
+	};
+
+	SDL_SpinLock tag_lock;
+	tag_counters_t tag_counters[alloc_tag::count];
+
+	void track_alloc(block_header_t *header) {
+		header->tag = uint8_t(t_tag);
+		tag_counters_t &t = tag_counters[header->tag];
+		SDL_AtomicLock(&tag_lock);
+		t.live_bytes += size_t(header->size);
+		t.live_count++;
+		t.frame_allocs++;
+		t.frame_bytes += size_t(header->size);
+		if (t.live_bytes > t.high_water) {
+			t.high_water = t.live_bytes;
+		}
+		SDL_AtomicUnlock(&tag_lock);
+	}
+
+	void track_free(block_header_t *header) {
+		tag_counters_t &t = tag_counters[header->tag];
+		SDL_AtomicLock(&tag_lock);
+		t.live_bytes -= size_t(header->size);
+		t.live_count--;
+		SDL_AtomicUnlock(&tag_lock);
+	}
+
+	void track_resize(block_header_t *header, size_t size) {
+		tag_counters_t &t = tag_counters[header->tag];
+		SDL_AtomicLock(&tag_lock);
+		t.live_bytes = t.live_bytes - size_t(header->size) + size;
+		if (t.live_bytes > t.high_water) {
+			t.high_water = t.live_bytes;
+		}
+		SDL_AtomicUnlock(&tag_lock);
+		header->size = size;
+	}
+#else
+	void track_alloc(block_header_t *) {}
+	void track_free(block_header_t *) {}
+	void track_resize(block_header_t *header, size_t size) {
+		header->size = size;
+	}
+#endif
+
+#if VBEAT_ALLOC_TRACE
+	const size_t trace_capacity = 4096;
+
+	/* One buffer for everyone, written out when it fills up. stdio and
+	 * atexit use the CRT's heap, not ours, so none of this comes back here. */
+	SDL_SpinLock  trace_lock;
+	FILE         *trace_file;
+	bool          trace_done; // closed, or couldn't open
+	alloc_trace_t trace_events[trace_capacity];
+	size_t        trace_count;
+	SDL_atomic_t  trace_threads;
+	VBEAT_THREAD_LOCAL uint32_t t_trace_thread;
+
+	void write_trace() {
+		if (trace_count > 0) {
+			fwrite(trace_events, sizeof(alloc_trace_t), trace_count, trace_file);
+			trace_count = 0;
+		}
+	}
+
+	void close_trace() {
+		SDL_AtomicLock(&trace_lock);
+		if (trace_file) {
+			write_trace();
+			fclose(trace_file);
+			trace_file = nullptr;
+		}
+		trace_done = true;
+		SDL_AtomicUnlock(&trace_lock);
+	}
+
+	void trace(uint8_t op, void *ptr, size_t size, size_t align) {
+		if (!ptr) {
+			return;
+		}
+		if (t_trace_thread == 0) {
+			t_trace_thread = uint32_t(SDL_AtomicAdd(&trace_threads, 1)) + 1;
+		}
+
+		alloc_trace_t e;
+		e.ptr    = uint64_t((uintptr_t)ptr);
+		e.size   = uint32_t(size);
+		e.thread = uint16_t(t_trace_thread);
+		e.op     = op;
+		e.align  = 0;
+		while ((size_t(1) << e.align) < align) {
+			e.align++;
+		}
+
+		SDL_AtomicLock(&trace_lock);
+		if (!trace_file && !trace_done) {
+			trace_file = fopen("alloc.trace", "wb");
+			trace_done = !trace_file;
+			if (trace_file) {
+				atexit(close_trace);
+			}
+		}
+		if (trace_file) {
+			trace_events[trace_count++] = e;
+			if (trace_count == trace_capacity) {
+				write_trace();
+			}
+		}
+		SDL_AtomicUnlock(&trace_lock);
+	}
+#else
+	void trace(uint8_t, void *, size_t, size_t) {}
+#endif
+
+#if VBEAT_ALLOC_GUARD
+	const int max_frames = 32;
+
+	VBEAT_THREAD_LOCAL const char *t_no_alloc;
+	VBEAT_THREAD_LOCAL int t_reporting;
+	bool guard_armed = false;
+
+	// Call stacks we've already complained about.
+	SDL_SpinLock seen_lock;
+	uint64_t seen[256];
+
+	int capture_stack(void **frames) {
+#	if defined(VBEAT_WINDOWS)
+		return int(CaptureStackBackTrace(0, max_frames, frames, NULL));
+#	elif defined(VBEAT_HAS_EXECINFO)
+		return backtrace(frames, max_frames);
+#	else
+		(void)frames;
+		return 0;
+#	endif
+	}
+
+	void report_forbidden(size_t bytes) {
+		void *frames[max_frames];
+		int n = capture_stack(frames);
+
+		uint64_t hash = 14695981039346656037ULL;
+		for (int i = 0; i < n; i++) {
+			hash = (hash ^ uint64_t((uintptr_t)frames[i])) * 1099511628211ULL;
+		}
+
+		bool fresh = true;
+		SDL_AtomicLock(&seen_lock);
+		size_t slot = size_t(hash % 256);
+		for (size_t i = 0; i < 256; i++) {
+			uint64_t &s = seen[(slot + i) % 256];
+			if (s == hash) {
+				fresh = false;
+				break;
+			}
+			if (s == 0) {
+				s = hash;
+				break;
+			}
+		}
+		SDL_AtomicUnlock(&seen_lock);
+		if (!fresh) {
+			return;
+		}
+
+		printf("Heap: %u byte allocation inside no-alloc scope \"%s\"\n",
+			unsigned(bytes), t_no_alloc
+		);
+#	if defined(VBEAT_HAS_EXECINFO)
+		// _fd variant, so we don't allocate while complaining about it.
+		backtrace_symbols_fd(frames, n, STDOUT_FILENO);
+#	else
+		for (int i = 0; i < n; i++) {
+			printf("  [%2d] %p\n", i, frames[i]);
+		}
+#	endif
+	}
+
+	void check_forbidden(size_t bytes) {
+		if (!guard_armed || !t_no_alloc || t_reporting) {
+			return;
+		}
+		t_reporting = 1;
+		report_forbidden(bytes);
+		t_reporting = 0;
+	}
+#else
+	void check_forbidden(size_t) {}
+#endif
+
+	// Pull a batch from the shared list into this thread's cache.
+	void refill(int c) {
+		central_list_t &list = central[c];
+		thread_cache_t &cache = t_cache;
+		uint32_t want = batch_size(c);
+
+		// taking a lock anyway, a couple of atomics more won't show.
+		pool_allocator_t::publish_thread_counts();
+
+		SDL_AtomicLock(&list.lock);
+		while (list.head && cache.count[c] < want) {
+			free_block_t *b = list.head;
+			list.head = b->next;
+			b->next = cache.head[c];
+			cache.head[c] = b;
+			cache.count[c]++;
+		}
+
+		if (cache.count[c] == 0) {
+			// Nothing shared either, cut up a fresh slab.
+			size_t size = class_size(c);
+			uint8_t *slab = (uint8_t*)::malloc(slab_size);
+			if (slab) {
+				size_t n = slab_size / size;
+				for (size_t i = 0; i < n; i++) {
+					free_block_t *b = (free_block_t*)(slab + i * size);
+					if (cache.count[c] < want) {
+						b->next = cache.head[c];
+						cache.head[c] = b;
+						cache.count[c]++;
+					}
+					else {
+						b->next = list.head;
+						list.head = b;
+					}
+				}
+			}
+		}
+		SDL_AtomicUnlock(&list.lock);
+	}
+
+	// Give a batch from this thread's cache back to the shared list.
+	void release(int c, uint32_t keep) {
+		central_list_t &list = central[c];
+		thread_cache_t &cache = t_cache;
+
+		SDL_AtomicLock(&list.lock);
+		while (cache.count[c] > keep) {
+			free_block_t *b = cache.head[c];
+			cache.head[c] = b->next;
+			b->next = list.head;
+			list.head = b;
+			cache.count[c]--;
+		}
+		SDL_AtomicUnlock(&list.lock);
+	}
+
+	void *alloc_small(size_t bytes) {
+		int c = size_to_class(bytes);
+		thread_cache_t &cache = t_cache;
+		if (!cache.head[c]) {
+			refill(c);
+			if (!cache.head[c]) {
+				return nullptr;
+			}
+		}
+
+		free_block_t *b = cache.head[c];
+		cache.head[c] = b->next;
+		cache.count[c]--;
+
+		block_header_t *header = (block_header_t*)b;
+		header->size_class = uint16_t(c);
+		header->offset = 0;
+		header->size = bytes;
+		track_alloc(header);
+		return (uint8_t*)header + header_size;
+	}
+
+	void *alloc_large(size_t bytes, size_t align) {
+		if (align < header_size) {
+			align = header_size;
+		}
+		pool_allocator_t::publish_thread_counts();
+		uint8_t *raw = (uint8_t*)::malloc(bytes + header_size + align - 1);
+		if (!raw) {
+			return nullptr;
+		}
+		uintptr_t user = ((uintptr_t)raw + header_size + align - 1) & ~(uintptr_t)(align - 1);
+		block_header_t *header = (block_header_t*)(user - header_size);
+		header->size_class = large_class;
+		header->offset = uint32_t((uint8_t*)header - raw);
+		header->size = bytes;
+		track_alloc(header);
+		return (void*)user;
+	}
+
+	void free_block(void *ptr) {
+		trace(alloc_trace_t::op_free, ptr, 0, 0);
+		block_header_t *header = (block_header_t*)((uint8_t*)ptr - header_size);
+		track_free(header);
+		if (header->size_class == large_class) {
+			::free((uint8_t*)header - header->offset);
+			return;
+		}
+
+		int c = int(header->size_class);
+		thread_cache_t &cache = t_cache;
+		free_block_t *b = (free_block_t*)header;
+		b->next = cache.head[c];
+		cache.head[c] = b;
+		cache.count[c]++;
+
+		uint32_t batch = batch_size(c);
+		if (cache.count[c] > batch * 2) {
+			release(c, batch);
+		}
+	}
+
+	size_t usable_size(void *ptr) {
+		block_header_t *header = (block_header_t*)((uint8_t*)ptr - header_size);
+		if (header->size_class == large_class) {
+			return size_t(header->size);
+		}
+		return class_size(int(header->size_class)) - header_size;
+	}
+
+	void *alloc_block(size_t bytes, size_t align) {
+		check_forbidden(bytes);
+		thread_cache_t &cache = t_cache;
+		cache.allocs      += 1;
+		cache.alloc_bytes += uint32_t(bytes);
+		void *ptr = bytes <= max_small && align <= header_size
+			? alloc_small(bytes)
+			: alloc_large(bytes, align);
+		trace(alloc_trace_t::op_alloc, ptr, bytes, align);
+		return ptr;
+	}
+}
+
+void *pool_allocator_t::realloc(void *_ptr, size_t _size, size_t _align, const char *, uint32_t) {
+	if (_size == 0) {
+		if (_ptr) {
+			free_block(_ptr);
+		}
+		return nullptr;
+	}
+
+	if (!_ptr) {
+		return alloc_block(_size, _align);
+	}
+
+	// Still fits and isn't mostly wasted, leave it where it is.
+	size_t usable = usable_size(_ptr);
+	bool aligned = ((uintptr_t)_ptr & (_align > 0 ? _align - 1 : 0)) == 0;
+	if (aligned && _size <= usable && _size > usable / 2) {
+		track_resize((block_header_t*)((uint8_t*)_ptr - header_size), _size);
+		return _ptr;
+	}
+
+	void *ptr = alloc_block(_size, _align);
+	if (ptr) {
+		memcpy(ptr, _ptr, usable < _size ? usable : _size);
+		free_block(_ptr);
+	}
+	return ptr;
+}
+
+void pool_allocator_t::flush_thread_cache() {
+	for (int c = 0; c < num_classes; c++) {
+		if (t_cache.count[c] > 0) {
+			release(c, 0);
+		}
+	}
+	publish_thread_counts();
+}
+
+void pool_allocator_t::publish_thread_counts() {
+	thread_cache_t &cache = t_cache;
+	if (cache.allocs == 0) {
+		return;
+	}
+	hitch::count(hitch::counter::allocs, cache.allocs);
+	hitch::count(hitch::counter::alloc_bytes, cache.alloc_bytes);
+	cache.allocs      = 0;
+	cache.alloc_bytes = 0;
+}
+
+alloc_tag::Enum vbeat::v_set_alloc_tag(alloc_tag::Enum tag) {
+#if VBEAT_HEAP_TRACKING
+	alloc_tag::Enum prev = alloc_tag::Enum(t_tag);
+	t_tag = int(tag);
+	return prev;
+#else
+	(void)tag;
+	return alloc_tag::general;
+#endif
+}
+
+const char *vbeat::v_alloc_tag_name(alloc_tag::Enum tag) {
+	static const char *names[] = {
+		"general",
+		"texture",
+		"font",
+		"mesh",
+		"chart",
+		"ui",
+		"fs"
+	};
+	return tag < alloc_tag::count ? names[tag] : "?";
+}
+
+#if VBEAT_HEAP_TRACKING
+void vbeat::v_heap_stats(heap_tag_stats_t (&stats)[alloc_tag::count]) {
+	SDL_AtomicLock(&tag_lock);
+	for (int i = 0; i < alloc_tag::count; i++) {
+		const tag_counters_t &t = tag_counters[i];
+		stats[i].live_bytes   = t.live_bytes;
+		stats[i].live_count   = t.live_count;
+		stats[i].frame_allocs = t.last_allocs;
+		stats[i].frame_bytes  = t.last_bytes;
+		stats[i].high_water   = t.high_water;
+	}
+	SDL_AtomicUnlock(&tag_lock);
+}
+
+void vbeat::v_heap_frame() {
+	SDL_AtomicLock(&tag_lock);
+	for (int i = 0; i < alloc_tag::count; i++) {
+		tag_counters_t &t = tag_counters[i];
+		t.last_allocs  = t.frame_allocs;
+		t.last_bytes   = t.frame_bytes;
+		t.frame_allocs = 0;
+		t.frame_bytes  = 0;
+	}
+	SDL_AtomicUnlock(&tag_lock);
+}
+
+void vbeat::v_heap_report() {
+	heap_tag_stats_t stats[alloc_tag::count];
+	v_heap_stats(stats);
+	for (int i = 0; i < alloc_tag::count; i++) {
+		if (stats[i].live_count == 0) {
+			continue;
+		}
+		printf("Heap: %u bytes in %u blocks still live for tag \"%s\" (peak %u bytes).\n",
+			unsigned(stats[i].live_bytes), unsigned(stats[i].live_count),
+			v_alloc_tag_name(alloc_tag::Enum(i)), unsigned(stats[i].high_water)
+		);
+	}
+}
+#endif
+
+no_alloc_scope::no_alloc_scope(const char *name) {
+#if VBEAT_ALLOC_GUARD
+	prev = t_no_alloc;
+	t_no_alloc = name;
+#else
+	(void)name;
+	prev = nullptr;
+#endif
+}
+
+no_alloc_scope::~no_alloc_scope() {
+#if VBEAT_ALLOC_GUARD
+	t_no_alloc = prev;
+#endif
+}
+
+#if VBEAT_ALLOC_GUARD
+void vbeat::v_set_alloc_guard(bool armed) {
+	guard_armed = armed;
+	printf("Heap: no-alloc scopes %s.\n", armed ? "armed" : "disarmed");
+}
+
+bool vbeat::v_alloc_guard_armed() {
+	return guard_armed;
+}
+#endif
+
+// The front end everything allocates through.
+bx::AllocatorI* vbeat::get_allocator()
+{
+	static pool_allocator_t s_allocator;
+	return &s_allocator;
+}
+
+// c-style allocs... everything that allocates calls these.
+void *vbeat::v_malloc(size_t bytes) {
+	return bx::alloc(vbeat::get_allocator(), bytes);
+}
+
+void *vbeat::v_malloc(size_t bytes, alloc_tag::Enum tag) {
+#if VBEAT_HEAP_TRACKING
+	alloc_tag_scope scope(tag);
+	return bx::alloc(vbeat::get_allocator(), bytes);
+#else
+	(void)tag;
+	return bx::alloc(vbeat::get_allocator(), bytes);
+#endif
+}
+
+void *vbeat::v_realloc(void *ptr, size_t new_size) {
+	return bx::realloc(vbeat::get_allocator(), ptr, new_size);
+}
+
+void vbeat::v_free(void *ptr) {
+	bx::free(vbeat::get_allocator(), ptr);
+}
+
+#ifndef VBEAT_FRAME_ARENA_SIZE
+#	define VBEAT_FRAME_ARENA_SIZE (1 << 20)
+#endif
+
+namespace {
+	const size_t frame_align = 16;
+
+	// heap fallback blocks, chained together so reset can free them.
+	struct frame_overflow_t {
+		frame_overflow_t *next;
+		size_t size;
+	};
+
+	/* Two arenas, swapped on every reset. The render thread may still be
+	 * reading last frame's data (anything passed to bgfx::makeRef), so it
+	 * stays put until the reset after this one. */
+	struct frame_arena_t {
+		uint8_t *base;
+		size_t used;
+		size_t overflow;
+		frame_overflow_t *spilled;
+	};
+
+	// static storage so the arenas themselves never touch the heap.
+	uint64_t frame_storage[2][VBEAT_FRAME_ARENA_SIZE / sizeof(uint64_t) + frame_align];
+
+	uint8_t *frame_base(int i) {
+		return (uint8_t*)(((uintptr_t)frame_storage[i] + frame_align - 1) & ~(frame_align - 1));
+	}
+
+	frame_arena_t frame_arenas[2] = {
+		{ frame_base(0), 0, 0, nullptr },
+		{ frame_base(1), 0, 0, nullptr }
+	};
+	int    frame_current    = 0;
+	size_t frame_high_water = 0;
+
+	size_t frame_align_up(size_t bytes) {
+		return (bytes + frame_align - 1) & ~(frame_align - 1);
+	}
+}
+
+void *vbeat::v_frame_alloc(size_t bytes) {
+	frame_arena_t &a = frame_arenas[frame_current];
+	size_t size = frame_align_up(bytes);
+	if (size <= VBEAT_FRAME_ARENA_SIZE - a.used) {
+		void *ptr = a.base + a.used;
+		a.used += size;
+		return ptr;
+	}
+
+	// Out of room. Spill to the heap, the header keeps 16 byte alignment.
+	size_t header = frame_align_up(sizeof(frame_overflow_t));
+	uint8_t *block = (uint8_t*)v_malloc(header + size);
+	if (!block) {
+		return nullptr;
+	}
+	frame_overflow_t *spill = (frame_overflow_t*)block;
+	spill->next = a.spilled;
+	spill->size = size;
+	a.spilled = spill;
+	a.overflow += size;
+	return block + header;
+}
+
+void vbeat::v_frame_reset() {
+	size_t total = frame_arenas[frame_current].used + frame_arenas[frame_current].overflow;
+	if (total > frame_high_water) {
+		frame_high_water = total;
+	}
+
+	// The one we're switching to was handed out two frames ago.
+	frame_current ^= 1;
+	frame_arena_t &a = frame_arenas[frame_current];
+	while (a.spilled) {
+		frame_overflow_t *next = a.spilled->next;
+		v_free(a.spilled);
+		a.spilled = next;
+	}
+
+	a.used = 0;
+	a.overflow = 0;
+}
+
+frame_stats_t vbeat::v_frame_stats() {
+	const frame_arena_t &a = frame_arenas[frame_current];
+	frame_stats_t stats = {
+		VBEAT_FRAME_ARENA_SIZE,
+		a.used,
+		a.overflow,
+		frame_high_water
+	};
+	return stats;
+}
+
+// c++-style allocs. redirects to v_*
+void* operator new(size_t sz) {
+	void *ptr = vbeat::v_malloc(sz);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete(void* ptr) VBEAT_NOEXCEPT
+{
+	vbeat::v_free(ptr);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <bx/allocator.h>
+
+namespace vbeat {
+
+/* What VBEAT_ALLOC_TRACE builds write to alloc.trace: one of these per
+ * block handed out or taken back, in the order they happened. */
+struct alloc_trace_t {
+	enum {
+		op_alloc = 0,
+		op_free
+	};
+
+	uint64_t ptr;
+	uint32_t size;   // op_alloc only
+	uint16_t thread; // numbered from 1 as threads first show up
+	uint8_t  op;
+	uint8_t  align;  // log2
+};
+
+/* Segregated-fit small object allocator. This is what's behind
+ * get_allocator(), so everything (v_malloc, new/delete, lodepng, bgfx) ends
+ * up here.
+ *
+ * Requests up to max_small bytes are rounded up to one of a set of size
+ * classes. Each thread keeps a short free list per class, so the common case
+ * is a pop/push with no locking at all; when a thread's list runs dry or gets
+ * too long, it trades a batch of blocks with the shared per-class list, which
+ * is guarded by a spinlock. Shared lists are refilled by carving up slabs
+ * straight from the CRT, and slabs are never handed back.
+ *
+ * Anything bigger, or that needs more than 16 byte alignment, goes straight
+ * through to the CRT. */
+struct pool_allocator_t : public bx::AllocatorI {
+	enum {
+		header_size = 16,
+		max_small   = 4096 - header_size,
+		num_classes = 27
+	};
+
+	virtual ~pool_allocator_t() {}
+
+	virtual void *realloc(void *_ptr, size_t _size, size_t _align, const char *_file, uint32_t _line);
+
+	// Hand this thread's cached blocks back to the shared lists. Threads we
+	// start ourselves should call this on the way out, otherwise whatever
+	// they had cached is stranded.
+	static void flush_thread_cache();
+
+	/* Allocations are counted per thread and only handed to hitch when the
+	 * thread goes to the shared lists or the CRT anyway, so the fast path
+	 * stays free of shared writes. This hands over the rest now; hitch's
+	 * frame() does it for the game thread. */
+	static void publish_thread_counts();
+};
+
+} // vbeat
@@ -0,0 +1,132 @@
+#include <cstring>
+
+#include "profiler.hpp"
+#include "chart/analysis.hpp"
+
+namespace vbeat {
+namespace chart {
+
+namespace {
+	// Same lane again this soon is a jack (a 16th at 75 bpm, give or take).
+	const uint32_t jack_ms = 200;
+
+	// Single notes this close together, this many in a row, make a stream.
+	const uint32_t stream_ms   = 200;
+	const uint32_t stream_rows = 16;
+
+	uint32_t count_bits(uint8_t bits) {
+		uint32_t n = 0;
+		for (; bits; bits &= bits - 1) {
+			n++;
+		}
+		return n;
+	}
+}
+
+void analyze(const chart_t &chart, metrics_t &m) {
+	VBEAT_PROFILE_SCOPE("chart::analyze");
+	memset(&m, 0, sizeof(m));
+
+	const std::vector<note_row_t> &rows = chart.rows;
+	size_t first = rows.size(), last = 0;
+
+	// Sliding one second window: the front adds notes, the back takes them off.
+	uint32_t window = 0;
+	size_t   back   = 0;
+
+	uint32_t run = 0, prev_ms = 0;
+	uint8_t  prev_lanes = 0;
+
+	for (size_t i = 0; i < rows.size(); i++) {
+		const note_row_t &row = rows[i];
+		// tails aren't hit.
+		if (row.columns & HOLD_TAIL) {
+			continue;
+		}
+		uint8_t  lanes = row.columns & NOTE6_MASK;
+		uint32_t n     = count_bits(lanes);
+		if (n == 0) {
+			continue;
+		}
+
+		if (first == rows.size()) {
+			first = i;
+		}
+		last = i;
+
+		m.notes += n;
+		for (int l = 0; l < metrics_t::lanes; l++) {
+			m.lane_notes[l] += (lanes >> l) & 1;
+		}
+		if (n == 2) {
+			m.chords++;
+		} else if (n > 2) {
+			m.hands++;
+		}
+
+		bool close = m.notes > n && row.ms - prev_ms <= jack_ms;
+		if (close) {
+			m.jacks += count_bits(lanes & prev_lanes);
+		}
+
+		// streams: runs of single notes, none too far apart.
+		if (n == 1 && (run == 0 || row.ms - prev_ms <= stream_ms)) {
+			run++;
+		} else {
+			if (run >= stream_rows) {
+				m.stream_notes += run;
+			}
+			if (run > m.longest_stream) {
+				m.longest_stream = run;
+			}
+			run = n == 1 ? 1 : 0;
+		}
+
+		window += n;
+		while (rows[back].ms + 1000 <= row.ms) {
+			const note_row_t &b = rows[back++];
+			if (!(b.columns & HOLD_TAIL)) {
+				window -= count_bits(b.columns & NOTE6_MASK);
+			}
+		}
+		if (float(window) > m.peak_nps) {
+			m.peak_nps = float(window);
+		}
+
+		prev_ms    = row.ms;
+		prev_lanes = lanes;
+	}
+	if (run >= stream_rows) {
+		m.stream_notes += run;
+	}
+	if (run > m.longest_stream) {
+		m.longest_stream = run;
+	}
+
+	if (m.notes == 0) {
+		return;
+	}
+	m.length_ms = rows[last].ms - rows[first].ms;
+	if (m.length_ms > 0) {
+		m.average_nps = float(m.notes) * 1000.f / float(m.length_ms);
+	}
+
+	// density: notes per second in each slice of the chart.
+	double slice = double(m.length_ms + 1) / double(metrics_t::density_points);
+	uint32_t counts[metrics_t::density_points] = {};
+	for (size_t i = first; i <= last; i++) {
+		const note_row_t &row = rows[i];
+		if (row.columns & HOLD_TAIL) {
+			continue;
+		}
+		size_t p = size_t(double(row.ms - rows[first].ms) / slice);
+		counts[p < metrics_t::density_points ? p : metrics_t::density_points - 1] += count_bits(row.columns & NOTE6_MASK);
+	}
+	for (int p = 0; p < metrics_t::density_points; p++) {
+		double nps = double(counts[p]) * 1000.0 / slice;
+		m.density[p] = uint16_t(nps < 65535.0 ? nps + 0.5 : 65535.0);
+	}
+}
+
+} // chart
+} // vbeat
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+#include "chart/chart.hpp"
+
+namespace vbeat {
+namespace chart {
+
+/* What a chart looks like to play, for song select and sorting. Fixed
+ * size, it lives in the library index. */
+struct metrics_t {
+	enum {
+		lanes          = 6,
+		density_points = 32
+	};
+
+	uint32_t notes;
+	uint32_t length_ms;     // first note to last
+	float    peak_nps;      // most notes in any one second
+	float    average_nps;
+
+	uint32_t jacks;         // notes hitting a lane that was just hit
+	uint32_t stream_notes;  // notes in runs of quick single notes
+	uint32_t longest_stream;
+	uint32_t chords;        // rows with 2 notes
+	uint32_t hands;         // rows with 3 or more
+	uint32_t lane_notes[lanes];
+
+	// notes per second across the chart, evenly spaced.
+	uint16_t density[density_points];
+};
+
+// One pass over the rows, no allocation. chart needs its times computed.
+void analyze(const chart_t &chart, metrics_t &m);
+
+} // chart
+} // vbeat
@@ -0,0 +1,297 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "profiler.hpp"
+#include "chart/binary.hpp"
+
+namespace vbeat {
+namespace chart {
+
+namespace {
+	void align(std::vector<uint8_t> &out) {
+		out.resize((out.size() + 7) & ~size_t(7), 0);
+	}
+
+	template <typename T>
+	void append(std::vector<uint8_t> &out, const T *items, size_t count) {
+		if (count == 0) {
+			return;
+		}
+		size_t at = out.size();
+		out.resize(at + sizeof(T) * count);
+		memcpy(&out[at], items, sizeof(T) * count);
+	}
+
+	block_t write_timing(const timing_t &timing, std::vector<uint8_t> &out) {
+		align(out);
+		block_t block;
+		block.offset = uint32_t(out.size());
+
+		timing_block_t tb;
+		memset(&tb, 0, sizeof(tb));
+		tb.offset      = timing.offset;
+		tb.num_bpms    = uint32_t(timing.bpms.size());
+		tb.num_stops   = uint32_t(timing.stops.size());
+		tb.num_scrolls = uint32_t(timing.scrolls.size());
+		append(out, &tb, 1);
+		append(out, timing.bpms.data(), timing.bpms.size());
+
+		// stops have padding after the bool; zero it so the same chart
+		// always makes the same file.
+		for (auto &s : timing.stops) {
+			stop_segment_t stop;
+			memset(&stop, 0, sizeof(stop));
+			stop.beat    = s.beat;
+			stop.seconds = s.seconds;
+			stop.delay   = s.delay;
+			append(out, &stop, 1);
+		}
+		append(out, timing.scrolls.data(), timing.scrolls.size());
+
+		block.size = uint32_t(out.size() - block.offset);
+		return block;
+	}
+
+	bool same_timing(const timing_t &a, const timing_t &b) {
+		if (a.offset != b.offset
+			|| a.bpms.size() != b.bpms.size()
+			|| a.stops.size() != b.stops.size()
+			|| a.scrolls.size() != b.scrolls.size()
+		) {
+			return false;
+		}
+		for (size_t i = 0; i < a.bpms.size(); i++) {
+			if (a.bpms[i].beat != b.bpms[i].beat || a.bpms[i].bpm != b.bpms[i].bpm) {
+				return false;
+			}
+		}
+		for (size_t i = 0; i < a.stops.size(); i++) {
+			const stop_segment_t &x = a.stops[i], &y = b.stops[i];
+			if (x.beat != y.beat || x.seconds != y.seconds || x.delay != y.delay) {
+				return false;
+			}
+		}
+		for (size_t i = 0; i < a.scrolls.size(); i++) {
+			if (a.scrolls[i].beat != b.scrolls[i].beat || a.scrolls[i].factor != b.scrolls[i].factor) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool in_bounds(const block_t &block, size_t size) {
+		return block.offset % 8 == 0 && block.offset <= size && size - block.offset >= block.size;
+	}
+
+	uint32_t count_notes(uint8_t columns) {
+		if (columns & HOLD_TAIL) {
+			return 0;
+		}
+		uint32_t n = 0;
+		for (uint8_t c = columns & NOTE6_MASK; c; c &= c - 1) {
+			n++;
+		}
+		return n;
+	}
+}
+
+bool write_binary(const song_t &song, const chart_t *charts, std::vector<uint8_t> &out) {
+	VBEAT_PROFILE_SCOPE("chart::write_binary");
+	uint32_t n = song.num_charts;
+	out.clear();
+
+	header_t h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, "VBCH", 4);
+	h.version     = BINARY_VERSION;
+	h.num_charts  = n;
+	h.meta.offset = uint32_t(sizeof(header_t));
+	h.meta.size   = uint32_t(sizeof(metadata_t) + n * sizeof(chart_entry_t));
+
+	// header and meta get filled in last, once everything has a place.
+	out.resize(h.meta.offset + h.meta.size, 0);
+	h.timing = write_timing(song.timing, out);
+
+	std::vector<chart_entry_t> entries(n);
+	std::vector<sync_t>        syncs;
+	std::vector<packed_row_t>  packed;
+	for (uint32_t i = 0; i < n; i++) {
+		const chart_t &c = charts[i];
+		chart_entry_t &e = entries[i];
+		memset(&e, 0, sizeof(e));
+		e.info   = song.charts[i];
+		e.timing = same_timing(c.timing, song.timing) ? h.timing : write_timing(c.timing, out);
+
+		syncs.clear();
+		packed.clear();
+		packed.reserve(c.rows.size());
+
+		int32_t tick = 0;
+		for (size_t r = 0; r < c.rows.size(); r++) {
+			const note_row_t &row = c.rows[r];
+			int32_t t = int32_t(floor(double(row.beat) * TICKS_PER_BEAT + 0.5));
+			if (r > 0 && t < tick) {
+				printf("Chart: Rows out of order in chart %u (beat %f).\n", i, row.beat);
+				return false;
+			}
+
+			int32_t gap = r > 0 ? t - tick : 0;
+			for (;;) {
+				uint16_t step = uint16_t(gap < 0xFFFF ? gap : 0xFFFF);
+				gap  -= step;
+				tick  = t - gap;
+				if (packed.size() % SYNC_INTERVAL == 0) {
+					sync_t s = { tick };
+					syncs.push_back(s);
+				}
+				packed_row_t p = { step, uint8_t(gap > 0 ? 0 : row.columns), 0 };
+				packed.push_back(p);
+				if (gap == 0) {
+					break;
+				}
+			}
+
+			e.num_notes += count_notes(row.columns);
+			e.length_ms  = row.ms;
+		}
+		e.num_rows  = uint32_t(packed.size());
+		e.num_syncs = uint32_t(syncs.size());
+
+		align(out);
+		e.notes.offset = uint32_t(out.size());
+		append(out, syncs.data(), syncs.size());
+		append(out, packed.data(), packed.size());
+		e.notes.size = uint32_t(out.size() - e.notes.offset);
+	}
+	align(out);
+	h.file_size = uint32_t(out.size());
+
+	memcpy(&out[0], &h, sizeof(h));
+	memcpy(&out[h.meta.offset], &song.meta, sizeof(metadata_t));
+	if (n > 0) {
+		memcpy(&out[h.meta.offset + sizeof(metadata_t)], entries.data(), n * sizeof(chart_entry_t));
+	}
+	return true;
+}
+
+bool binary_t::open(bool meta_only) {
+	this->complete = false;
+	size_t size = this->data.size();
+	if (size < sizeof(header_t)) {
+		return false;
+	}
+
+	const header_t *h = this->header();
+	if (memcmp(h->magic, "VBCH", 4) != 0) {
+		return false;
+	}
+	if (h->version != BINARY_VERSION) {
+		printf("Chart: Version %u, want %u.\n", h->version, unsigned(BINARY_VERSION));
+		return false;
+	}
+	if (h->num_charts > uint32_t(song_t::max_charts)
+		|| !in_bounds(h->meta, size)
+		|| h->meta.size < sizeof(metadata_t) + h->num_charts * sizeof(chart_entry_t)
+	) {
+		return false;
+	}
+	if (meta_only) {
+		return true;
+	}
+
+	if (h->file_size != size || !in_bounds(h->timing, size)) {
+		return false;
+	}
+	const chart_entry_t *charts = this->charts();
+	for (uint32_t i = 0; i < h->num_charts; i++) {
+		const chart_entry_t &e = charts[i];
+		uint32_t want_syncs = (e.num_rows + SYNC_INTERVAL - 1) / SYNC_INTERVAL;
+		if (!in_bounds(e.timing, size) || !in_bounds(e.notes, size)
+			|| e.num_syncs != want_syncs
+			|| uint64_t(e.notes.size) < uint64_t(e.num_syncs) * sizeof(sync_t) + uint64_t(e.num_rows) * sizeof(packed_row_t)
+		) {
+			return false;
+		}
+	}
+	this->complete = true;
+	return true;
+}
+
+const header_t *binary_t::header() const {
+	return (const header_t*)this->data.data();
+}
+
+const metadata_t *binary_t::meta() const {
+	return (const metadata_t*)(this->data.data() + this->header()->meta.offset);
+}
+
+const chart_entry_t *binary_t::charts() const {
+	return (const chart_entry_t*)(this->meta() + 1);
+}
+
+const sync_t *binary_t::syncs(uint32_t chart) const {
+	return (const sync_t*)(this->data.data() + this->charts()[chart].notes.offset);
+}
+
+const packed_row_t *binary_t::rows(uint32_t chart) const {
+	return (const packed_row_t*)(this->syncs(chart) + this->charts()[chart].num_syncs);
+}
+
+bool binary_t::read_timing(const block_t &block, timing_t &timing) const {
+	if (!this->complete || block.size < sizeof(timing_block_t)) {
+		return false;
+	}
+	const uint8_t *p = this->data.data() + block.offset;
+	const timing_block_t *tb = (const timing_block_t*)p;
+	uint64_t need = sizeof(timing_block_t)
+		+ uint64_t(tb->num_bpms)    * sizeof(bpm_segment_t)
+		+ uint64_t(tb->num_stops)   * sizeof(stop_segment_t)
+		+ uint64_t(tb->num_scrolls) * sizeof(scroll_segment_t);
+	if (need > block.size) {
+		return false;
+	}
+
+	const bpm_segment_t    *bpms    = (const bpm_segment_t*)(tb + 1);
+	const stop_segment_t   *stops   = (const stop_segment_t*)(bpms + tb->num_bpms);
+	const scroll_segment_t *scrolls = (const scroll_segment_t*)(stops + tb->num_stops);
+	timing.offset = tb->offset;
+	timing.bpms.assign(bpms, bpms + tb->num_bpms);
+	timing.stops.assign(stops, stops + tb->num_stops);
+	timing.scrolls.assign(scrolls, scrolls + tb->num_scrolls);
+	timing.build();
+	return true;
+}
+
+bool binary_t::decode(uint32_t chart, chart_t &out) const {
+	VBEAT_PROFILE_SCOPE("chart::binary_t::decode");
+	if (!this->complete || chart >= this->header()->num_charts) {
+		return false;
+	}
+	const chart_entry_t &e = this->charts()[chart];
+	if (!this->read_timing(e.timing, out.timing)) {
+		return false;
+	}
+
+	const sync_t       *syncs = this->syncs(chart);
+	const packed_row_t *rows  = this->rows(chart);
+	out.rows.clear();
+	out.rows.reserve(e.num_rows);
+
+	int32_t tick = 0;
+	for (uint32_t i = 0; i < e.num_rows; i++) {
+		tick = i % SYNC_INTERVAL == 0 ? syncs[i / SYNC_INTERVAL].tick : tick + rows[i].delta;
+		if (rows[i].columns == 0) {
+			continue;
+		}
+		note_row_t row = { float(tick) / float(TICKS_PER_BEAT), 0, rows[i].columns };
+		out.rows.push_back(row);
+	}
+
+	// already in order and merged when it was written.
+	out.compute_times();
+	return true;
+}
+
+} // chart
+} // vbeat
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chart/chart.hpp"
+#include "chart/sm.hpp"
+
+namespace vbeat {
+namespace chart {
+
+/* .vbc, our own chart format. Laid out the way it gets used, so loading is
+ * one read and a bounds check:
+ *
+ *   header_t
+ *   meta:    metadata_t, chart_entry_t[num_charts]
+ *   timing:  timing_block_t, bpm_segment_t[], stop_segment_t[],
+ *            scroll_segment_t[] (the song's, then any chart's own)
+ *   notes:   sync_t[], packed_row_t[] per chart
+ *
+ * Offsets are from the start of the file and every block starts 8 aligned.
+ * The meta block comes straight after the header, so song select only
+ * needs the first meta_bytes of the file. Little endian only. */
+enum {
+	BINARY_VERSION = 1,
+
+	// StepMania's own resolution, anything finer doesn't survive its editor
+	TICKS_PER_BEAT = 48,
+
+	// rows between absolute positions, for starting partway through
+	SYNC_INTERVAL  = 256
+};
+
+struct block_t {
+	uint32_t offset;
+	uint32_t size;
+};
+
+struct header_t {
+	char     magic[4]; // "VBCH"
+	uint32_t version;
+	uint32_t file_size;
+	uint32_t num_charts;
+	block_t  meta;
+	block_t  timing; // the song's
+};
+
+struct chart_entry_t {
+	chart_info_t info;
+	block_t  timing;     // its own, or the same as the song's
+	block_t  notes;
+	uint32_t num_rows;   // packed rows, spacers included
+	uint32_t num_syncs;
+	uint32_t num_notes;  // things to hit, for song select
+	uint32_t length_ms;  // last row
+};
+
+struct timing_block_t {
+	double   offset;
+	uint32_t num_bpms;
+	uint32_t num_stops;
+	uint32_t num_scrolls;
+	uint32_t unused;
+};
+
+/* Ticks since the last row. A gap too big for 16 bits gets spacer rows
+ * with no columns, which the reader skips. */
+struct packed_row_t {
+	uint16_t delta;
+	uint8_t  columns;
+	uint8_t  unused;
+};
+
+// Absolute tick of row n*SYNC_INTERVAL.
+struct sync_t {
+	int32_t tick;
+};
+
+// Everything up to the end of the meta block, at most.
+const size_t meta_bytes = sizeof(header_t) + sizeof(metadata_t) + song_t::max_charts * sizeof(chart_entry_t);
+
+/* A .vbc in memory. Everything hands out pointers into data; nothing is
+ * unpacked until decode(). */
+struct binary_t {
+	// Check a file that's been read into data. With meta_only, only the
+	// header and meta block have to be there (see meta_bytes).
+	bool open(bool meta_only = false);
+
+	const header_t      *header() const;
+	const metadata_t    *meta() const;
+	const chart_entry_t *charts() const; // header()->num_charts of them
+	const sync_t        *syncs(uint32_t chart) const;
+	const packed_row_t  *rows(uint32_t chart) const;
+
+	// Segments into timing, built.
+	bool read_timing(const block_t &block, timing_t &timing) const;
+
+	// The rows, timing and times a chart_t needs to be played.
+	bool decode(uint32_t chart, chart_t &out) const;
+
+	std::vector<uint8_t> data;
+	bool complete; // false if only the meta block was checked
+};
+
+/* song and one chart_t per song.charts entry (empty rows for ones we can't
+ * play) into a .vbc. Rows have to be in order. */
+bool write_binary(const song_t &song, const chart_t *charts, std::vector<uint8_t> &out);
+
+// Through the VFS. See chart/load.cpp.
+bool load_binary(const std::string &filename, binary_t &bin, bool meta_only = false);
+
+/* Chart number `which` out of a .vbc, or a .sm/.ssc going by the extension,
+ * with the song's metadata into meta if it's given. */
+bool load_chart(const std::string &filename, chart_t &chart, int which = 0, metadata_t *meta = nullptr);
+
+} // chart
+} // vbeat
@@ -0,0 +1,143 @@
+#include <algorithm>
+
+#include "hash.hpp"
+#include "chart/chart.hpp"
+
+namespace vbeat {
+namespace chart {
+
+namespace {
+	// Past this many steps, a binary search is cheaper than walking.
+	const size_t max_walk = 32;
+
+	bool row_before(const note_row_t &a, const note_row_t &b) {
+		return a.ms < b.ms;
+	}
+
+	// Move i forward to the first row where ms passes the test, or give up
+	// after a few and binary search the rest.
+	template <typename Past>
+	size_t walk(const chart_t &c, size_t i, Past past, size_t (chart_t::*search)(int64_t) const, int64_t ms) {
+		size_t n = c.rows.size();
+		for (size_t steps = 0; i < n && !past(c.rows[i].ms); steps++) {
+			if (steps == max_walk) {
+				return (c.*search)(ms);
+			}
+			i++;
+		}
+		return i;
+	}
+}
+
+void chart_t::compute_times() {
+	std::vector<double> times(this->rows.size());
+	for (size_t i = 0; i < this->rows.size(); i++) {
+		times[i] = this->rows[i].beat;
+	}
+	this->timing.beats_to_times(times.data(), times.data(), times.size());
+	for (size_t i = 0; i < this->rows.size(); i++) {
+		// nothing before the song starts
+		double ms = times[i] * 1000.0;
+		this->rows[i].ms = ms > 0.0 ? uint32_t(ms + 0.5) : 0;
+	}
+}
+
+void chart_t::sort() {
+	std::stable_sort(this->rows.begin(), this->rows.end(), row_before);
+
+	// merge rows that land on the same ms
+	size_t out = 0;
+	for (size_t i = 0; i < this->rows.size(); i++) {
+		if (out > 0 && this->rows[out - 1].ms == this->rows[i].ms
+			&& (this->rows[out - 1].columns & HOLD_MASK) == (this->rows[i].columns & HOLD_MASK)
+		) {
+			this->rows[out - 1].columns |= this->rows[i].columns;
+			continue;
+		}
+		this->rows[out++] = this->rows[i];
+	}
+	this->rows.resize(out);
+}
+
+uint64_t chart_t::hash() const {
+	// field by field, padding would make it depend on the compiler.
+	uint64_t h = hash::fnv_basis;
+	for (auto &r : this->rows) {
+		h = hash::fnv1a(&r.ms, sizeof(r.ms), h);
+		h = hash::fnv1a(&r.columns, sizeof(r.columns), h);
+	}
+	const timing_t &t = this->timing;
+	h = hash::fnv1a(&t.offset, sizeof(t.offset), h);
+	for (auto &s : t.bpms) {
+		h = hash::fnv1a(&s.beat, sizeof(s.beat), h);
+		h = hash::fnv1a(&s.bpm, sizeof(s.bpm), h);
+	}
+	for (auto &s : t.stops) {
+		uint8_t delay = s.delay ? 1 : 0;
+		h = hash::fnv1a(&s.beat, sizeof(s.beat), h);
+		h = hash::fnv1a(&s.seconds, sizeof(s.seconds), h);
+		h = hash::fnv1a(&delay, sizeof(delay), h);
+	}
+	for (auto &s : t.scrolls) {
+		h = hash::fnv1a(&s.beat, sizeof(s.beat), h);
+		h = hash::fnv1a(&s.factor, sizeof(s.factor), h);
+	}
+	return h;
+}
+
+size_t chart_t::lower_bound(int64_t ms) const {
+	size_t lo = 0, hi = this->rows.size();
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (int64_t(this->rows[mid].ms) < ms) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+size_t chart_t::upper_bound(int64_t ms) const {
+	size_t lo = 0, hi = this->rows.size();
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (int64_t(this->rows[mid].ms) <= ms) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+void cursor_t::reset(const chart_t *_chart) {
+	this->chart = _chart;
+	this->begin = 0;
+	this->end   = 0;
+}
+
+void cursor_t::seek(int64_t from, int64_t to) {
+	const chart_t &c = *this->chart;
+
+	// Going backwards means starting over.
+	if (this->begin > 0 && int64_t(c.rows[this->begin - 1].ms) >= from) {
+		this->begin = c.lower_bound(from);
+	} else {
+		this->begin = walk(c, this->begin, [from](uint32_t ms) { return int64_t(ms) >= from; }, &chart_t::lower_bound, from);
+	}
+
+	if (this->end > 0 && int64_t(c.rows[this->end - 1].ms) > to) {
+		this->end = c.upper_bound(to);
+	} else {
+		size_t start = this->end > this->begin ? this->end : this->begin;
+		this->end = walk(c, start, [to](uint32_t ms) { return int64_t(ms) > to; }, &chart_t::upper_bound, to);
+	}
+
+	if (this->end < this->begin) {
+		this->end = this->begin;
+	}
+}
+
+} // chart
+} // vbeat
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "chart/timing.hpp"
+
+namespace vbeat {
+namespace chart {
+
+/*
+ * columns is a bitfield.
+ * 76543210
+ * ||||||||
+ * |||||||+-- reserved (6key)
+ * |||++++--- notes
+ * ||+------- reserved (6key)
+ * ++-------- holds
+ *
+ * The hold bits say what the notes in the row are: bit 6 means they start
+ * holds, bit 7 means they end them (and aren't hit themselves). A row with
+ * taps and hold heads at once goes in as two rows on the same beat.
+ */
+enum {
+	NOTE4_MASK = 0x1E,
+	NOTE6_MASK = 0x3F,
+	HOLD_MASK  = 0xC0,
+	HOLD_HEAD  = 0x40,
+	HOLD_TAIL  = 0x80
+};
+
+struct note_row_t {
+	float    beat;
+	uint32_t ms; // from the timing, see chart_t::compute_times
+	uint8_t  columns;
+};
+
+// Rows in time order, so any time range is a contiguous run.
+struct chart_t {
+	std::vector<note_row_t> rows;
+	timing_t timing;
+
+	// Work out every row's ms from its beat. timing has to be built.
+	void compute_times();
+
+	// Put rows in order after filling them in; rows on the same ms (and
+	// the same hold bits) merge.
+	void sort();
+
+	/* Fingerprint of what gets played: when each row is and what's in it,
+	 * plus the timing. Beats are left out, so a .vbc and the .sm it came
+	 * from match as long as their notes land on the same ms. */
+	uint64_t hash() const;
+
+	// First row at or after ms / strictly after ms.
+	size_t lower_bound(int64_t ms) const;
+	size_t upper_bound(int64_t ms) const;
+};
+
+/* The rows between two times, [begin, end). Moving it forward a little at a
+ * time (i.e. once per tick or frame) costs about one step per row that
+ * enters or leaves; going backwards or jumping far ahead binary searches
+ * instead, so seeking around a long chart stays cheap. */
+struct cursor_t {
+	cursor_t(): chart(nullptr), begin(0), end(0) {}
+
+	void reset(const chart_t *_chart);
+
+	// Rows with from <= ms <= to.
+	void seek(int64_t from, int64_t to);
+
+	bool empty() const { return begin == end; }
+
+	const chart_t *chart;
+	size_t begin, end;
+};
+
+} // chart
+} // vbeat
@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <SDL2/SDL.h>
+
+#include "vbeat.hpp"
+#include "allocator.hpp"
+#include "clock.hpp"
+#include "fs.hpp"
+#include "hash.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
+#include "chart/binary.hpp"
+#include "chart/library.hpp"
+
+namespace vbeat {
+namespace chart {
+
+namespace {
+	const uint32_t index_version = 2;
+
+	struct index_header_t {
+		char     magic[4]; // "VBLI"
+		uint32_t version;
+		// catches the structs changing without anyone bumping the version
+		uint32_t song_size;
+		uint32_t chart_size;
+		uint32_t num_songs;
+		uint32_t num_charts;
+	};
+
+	bool ends_with(const std::string &s, const char *suffix) {
+		size_t n = strlen(suffix);
+		if (s.size() < n) {
+			return false;
+		}
+		for (size_t i = 0; i < n; i++) {
+			char c = s[s.size() - n + i];
+			if (c >= 'A' && c <= 'Z') {
+				c += 'a' - 'A';
+			}
+			if (c != suffix[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template <size_t N>
+	void copy(char (&dst)[N], const std::string &src) {
+		size_t n = src.size() < N - 1 ? src.size() : N - 1;
+		memcpy(dst, src.data(), n);
+		dst[n] = '\0';
+	}
+
+	bool folder_before(const library_song_t &a, const library_song_t &b) {
+		return strcmp(a.folder, b.folder) < 0;
+	}
+
+	// A folder that scan() has to read, and what came out of it.
+	struct read_t {
+		size_t                       folder; // into the folder list
+		fs::stat_t                   dir;
+		library_song_t               song;
+		std::vector<library_chart_t> charts;
+		bool                         ok;
+	};
+
+	/* Read one folder's chart file for its metadata. Best format wins.
+	 * Touches nothing but its arguments, so these can run side by side. */
+	bool read_song(const std::string &root, const std::string &name, const fs::stat_t &dir, library_song_t &song, std::vector<library_chart_t> &charts, song_t &scratch) {
+		static const char *exts[] = { ".vbc", ".ssc", ".sm" };
+
+		std::string path = root + "/" + name;
+		std::vector<std::string> items;
+		fs::get_directory_items(items, path);
+
+		std::string file;
+		size_t ext = 0;
+		for (; ext < sizeof(exts) / sizeof(exts[0]) && file.empty(); ext++) {
+			for (auto &item : items) {
+				if (ends_with(item, exts[ext]) && item.size() < sizeof(library_song_t::file)) {
+					file = item;
+					break;
+				}
+			}
+		}
+		if (file.empty()) {
+			return false;
+		}
+		ext -= 1;
+
+		std::string filename = path + "/" + file;
+		fs::stat_t st;
+		std::vector<uint8_t> data;
+		if (!fs::stat(filename, st) || !fs::read_vector(data, filename)) {
+			return false;
+		}
+
+		memset(&song, 0, sizeof(song));
+		copy(song.folder, name);
+		copy(song.file, file);
+		song.folder_mtime = dir.mtime;
+		song.file_mtime   = st.mtime;
+		song.file_size    = st.size;
+		song.hash         = hash::fnv1a(data.data(), data.size());
+
+		library_chart_t chart;
+		memset(&chart, 0, sizeof(chart));
+		if (ext == 0) {
+			binary_t bin;
+			bin.data.swap(data);
+			if (!bin.open(true)) {
+				printf("Library: %s isn't a chart we can read.\n", filename.c_str());
+				return false;
+			}
+			song.meta       = *bin.meta();
+			song.num_charts = bin.header()->num_charts;
+			for (uint32_t i = 0; i < song.num_charts; i++) {
+				chart.info = bin.charts()[i].info;
+				charts.push_back(chart);
+			}
+		} else {
+			parse_sm((const char*)data.data(), data.size(), ext == 1, scratch);
+			song.meta       = scratch.meta;
+			song.num_charts = scratch.num_charts;
+			for (uint32_t i = 0; i < song.num_charts; i++) {
+				chart.info = scratch.charts[i];
+				charts.push_back(chart);
+			}
+		}
+		return true;
+	}
+}
+
+bool library_t::load(const std::string &filename) {
+	VBEAT_PROFILE_SCOPE("library_t::load");
+	VBEAT_ALLOC_TAG(chart);
+	this->songs.clear();
+	this->charts.clear();
+
+	std::vector<uint8_t> data;
+	if (!fs::is_file(filename) || !fs::read_vector(data, filename)) {
+		return false;
+	}
+
+	index_header_t h;
+	if (data.size() < sizeof(h)) {
+		return false;
+	}
+	memcpy(&h, data.data(), sizeof(h));
+	if (memcmp(h.magic, "VBLI", 4) != 0
+		|| h.version    != index_version
+		|| h.song_size  != sizeof(library_song_t)
+		|| h.chart_size != sizeof(library_chart_t)
+		|| data.size()  != sizeof(h) + uint64_t(h.num_songs) * sizeof(library_song_t) + uint64_t(h.num_charts) * sizeof(library_chart_t)
+	) {
+		printf("Library: Index is from another version, starting over.\n");
+		return false;
+	}
+
+	const library_song_t  *songs  = (const library_song_t*)(data.data() + sizeof(h));
+	const library_chart_t *charts = (const library_chart_t*)(songs + h.num_songs);
+	this->songs.assign(songs, songs + h.num_songs);
+	this->charts.assign(charts, charts + h.num_charts);
+
+	// anything pointing outside the charts means the file's bad.
+	for (auto &s : this->songs) {
+		if (uint64_t(s.first_chart) + s.num_charts > h.num_charts) {
+			this->songs.clear();
+			this->charts.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool library_t::save(const std::string &filename) const {
+	VBEAT_PROFILE_SCOPE("library_t::save");
+	index_header_t h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, "VBLI", 4);
+	h.version    = index_version;
+	h.song_size  = sizeof(library_song_t);
+	h.chart_size = sizeof(library_chart_t);
+	h.num_songs  = uint32_t(this->songs.size());
+	h.num_charts = uint32_t(this->charts.size());
+
+	std::string out;
+	out.reserve(sizeof(h) + this->songs.size() * sizeof(library_song_t) + this->charts.size() * sizeof(library_chart_t));
+	out.append((const char*)&h, sizeof(h));
+	out.append((const char*)this->songs.data(), this->songs.size() * sizeof(library_song_t));
+	out.append((const char*)this->charts.data(), this->charts.size() * sizeof(library_chart_t));
+	return fs::write(filename, out);
+}
+
+uint32_t library_t::scan(const std::string &root, const library_t &cached, thread_pool_t *pool) {
+	VBEAT_PROFILE_SCOPE("library_t::scan");
+	VBEAT_ALLOC_TAG(chart);
+	std::vector<std::string> folders;
+	fs::get_directory_items(folders, root);
+	std::sort(folders.begin(), folders.end());
+
+	// what's the same as cached, straight from it; the rest gets read.
+	std::vector<const library_song_t*> same(folders.size(), nullptr);
+	std::vector<read_t> reads;
+	for (size_t i = 0; i < folders.size(); i++) {
+		const std::string &name = folders[i];
+		std::string path = root + "/" + name;
+		fs::stat_t dir;
+		if (!fs::stat(path, dir) || !dir.is_dir || name.size() >= sizeof(library_song_t::folder)) {
+			continue;
+		}
+
+		/* Files coming and going change the folder's mtime, but editing one
+		 * in place doesn't, so check the chart file itself too. */
+		const library_song_t *old = cached.find(name.c_str());
+		if (old && old->folder_mtime == dir.mtime) {
+			fs::stat_t st;
+			if (fs::stat(path + "/" + old->file, st) && st.mtime == old->file_mtime && st.size == old->file_size) {
+				same[i] = old;
+				continue;
+			}
+		}
+
+		read_t r;
+		r.folder = i;
+		r.dir    = dir;
+		r.ok     = false;
+		reads.push_back(r);
+	}
+
+	// Reading is most of the time on a cold library, so that's what gets spread out.
+	uint32_t workers = pool ? pool->size() : 1;
+	std::vector<song_t*> scratch(workers);
+	for (auto &s : scratch) {
+		s = new song_t();
+	}
+	auto read_one = [&](uint32_t job, uint32_t worker) {
+		VBEAT_ALLOC_TAG(chart); // the pool's threads don't have ours
+		read_t &r = reads[job];
+		r.ok = read_song(root, folders[r.folder], r.dir, r.song, r.charts, *scratch[worker]);
+	};
+	if (pool) {
+		pool->run(uint32_t(reads.size()), read_one);
+	} else {
+		for (uint32_t i = 0; i < reads.size(); i++) {
+			read_one(i, 0);
+		}
+	}
+	for (auto s : scratch) {
+		delete s;
+	}
+
+	// back together in folder order.
+	this->songs.clear();
+	this->charts.clear();
+	this->songs.reserve(folders.size());
+	this->charts.reserve(cached.charts.size());
+
+	uint32_t read = 0;
+	size_t next = 0;
+	for (size_t i = 0; i < folders.size(); i++) {
+		const library_song_t *old = same[i];
+		if (old) {
+			library_song_t song = *old;
+			song.first_chart = uint32_t(this->charts.size());
+			this->charts.insert(this->charts.end(),
+				cached.charts.begin() + old->first_chart,
+				cached.charts.begin() + old->first_chart + old->num_charts
+			);
+			this->songs.push_back(song);
+			continue;
+		}
+		if (next == reads.size() || reads[next].folder != i) {
+			continue;
+		}
+		read_t &r = reads[next++];
+		if (!r.ok) {
+			continue;
+		}
+		r.song.first_chart = uint32_t(this->charts.size());
+		this->charts.insert(this->charts.end(), r.charts.begin(), r.charts.end());
+		this->songs.push_back(r.song);
+		read += 1;
+	}
+	return read;
+}
+
+const library_song_t *library_t::find(const char *folder) const {
+	library_song_t key;
+	copy(key.folder, std::string(folder));
+	auto it = std::lower_bound(this->songs.begin(), this->songs.end(), key, folder_before);
+	if (it == this->songs.end() || strcmp(it->folder, folder) != 0) {
+		return nullptr;
+	}
+	return &*it;
+}
+
+namespace library {
+	namespace {
+		SDL_Thread  *thread = nullptr;
+		SDL_SpinLock ready_lock = 0;
+		library_t   *ready = nullptr; // finished check waiting for poll()
+
+		// the background thread's; nobody else touches these while it runs.
+		library_t    cached;
+		std::string  root, index;
+
+		int scan_main(void *) {
+			VBEAT_PROFILE_THREAD("library");
+			uint64_t start = clock::now();
+
+			library_t *fresh = new library_t();
+			uint32_t read = fresh->scan(root, cached);
+
+			double ms = double(clock::now() - start) * 1000.0 / double(clock::frequency());
+			printf("Library: Checked %u songs, read %u, in %.1fms.\n",
+				unsigned(fresh->songs.size()), read, ms
+			);
+
+			if (read > 0 || fresh->songs.size() != cached.songs.size()) {
+				if (!fresh->save(index)) {
+					printf("Library: Couldn't save %s.\n", index.c_str());
+				}
+				SDL_AtomicLock(&ready_lock);
+				ready = fresh;
+				SDL_AtomicUnlock(&ready_lock);
+			} else {
+				delete fresh;
+			}
+
+			cached = library_t();
+			pool_allocator_t::flush_thread_cache();
+			return 0;
+		}
+	}
+
+	void open(library_t &lib, const std::string &_root, const std::string &_index) {
+		if (lib.load(_index)) {
+			printf("Library: %u songs from the index.\n", unsigned(lib.songs.size()));
+		}
+
+		root   = _root;
+		index  = _index;
+		cached = lib;
+		thread = SDL_CreateThread(scan_main, "library", nullptr);
+	}
+
+	bool poll(library_t &lib) {
+		SDL_AtomicLock(&ready_lock);
+		library_t *fresh = ready;
+		ready = nullptr;
+		SDL_AtomicUnlock(&ready_lock);
+
+		if (!fresh) {
+			return false;
+		}
+		lib.songs.swap(fresh->songs);
+		lib.charts.swap(fresh->charts);
+		delete fresh;
+		printf("Library: Updated, %u songs.\n", unsigned(lib.songs.size()));
+		return true;
+	}
+
+	void close() {
+		if (thread) {
+			SDL_WaitThread(thread, nullptr);
+			thread = nullptr;
+		}
+		delete ready;
+		ready = nullptr;
+	}
+} // library
+
+} // chart
+} // vbeat
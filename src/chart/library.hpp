@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chart/sm.hpp"
+#include "chart/analysis.hpp"
+
+namespace vbeat {
+
+struct thread_pool_t;
+
+namespace chart {
+
+// One folder under the library root. Fixed size, written out as is.
+struct library_song_t {
+	char       folder[128]; // under the root
+	char       file[64];    // the chart file in it
+	int64_t    folder_mtime;
+	int64_t    file_mtime;
+	int64_t    file_size;
+	uint64_t   hash;        // of the chart file, see hash::fnv1a
+	metadata_t meta;
+	uint32_t   first_chart; // into library_t::charts
+	uint32_t   num_charts;
+};
+
+struct library_chart_t {
+	chart_info_t info;
+	metrics_t    metrics;  // zero until the analyzer gets to it
+	uint32_t     analyzed; // nonzero once metrics are filled in
+	uint32_t     unused;
+};
+
+/* Everything song select needs, without touching the songs. Kept in the
+ * write dir between runs so it's there the moment the game starts. */
+struct library_t {
+	std::vector<library_song_t>  songs; // by folder name
+	std::vector<library_chart_t> charts;
+
+	// One read. False (and empty) if it's missing or from another version.
+	bool load(const std::string &filename);
+	bool save(const std::string &filename) const;
+
+	/* Fill this in from the folders under root. Anything cached has that
+	 * looks the same on disk (folder and chart file mtimes, size) is copied
+	 * over; only the rest gets read, across pool if there is one. Returns
+	 * how many were read. */
+	uint32_t scan(const std::string &root, const library_t &cached, thread_pool_t *pool = nullptr);
+
+	const library_song_t *find(const char *folder) const;
+};
+
+/* The game's copy: loaded from the index straight away, then checked
+ * against the disk on a background thread. */
+namespace library {
+	void open(library_t &lib, const std::string &root, const std::string &index);
+
+	// If the background check found changes, swap them into lib (and say so).
+	bool poll(library_t &lib);
+
+	// Wait for the check to finish. Call before the VFS goes away.
+	void close();
+} // library
+
+} // chart
+} // vbeat
@@ -0,0 +1,77 @@
+/* The loaders that go through the VFS, kept apart from the formats so
+ * tools can use those without dragging PhysFS along. */
+
+#include <cstdio>
+
+#include "vbeat.hpp"
+#include "fs.hpp"
+#include "profiler.hpp"
+#include "chart/sm.hpp"
+#include "chart/binary.hpp"
+
+namespace vbeat {
+namespace chart {
+
+bool load_sm(const std::string &filename, song_t &song, chart_t *chart, int which) {
+	VBEAT_ALLOC_TAG(chart);
+	std::string data;
+	if (!fs::read_string(data, filename)) {
+		printf("Chart: Couldn't read %s\n", filename.c_str());
+		return false;
+	}
+
+	size_t dot = filename.find_last_of('.');
+	bool ssc = dot != std::string::npos && (
+		filename.compare(dot, std::string::npos, ".ssc") == 0 ||
+		filename.compare(dot, std::string::npos, ".SSC") == 0
+	);
+
+	// read_string tacks on a terminator, leave it off.
+	return parse_sm(data.data(), data.size() - 1, ssc, song, chart, which);
+}
+
+bool load_binary(const std::string &filename, binary_t &bin, bool meta_only) {
+	VBEAT_PROFILE_SCOPE("chart::load_binary");
+	VBEAT_ALLOC_TAG(chart);
+	int bytes = meta_only ? int(meta_bytes) : -1;
+	if (!fs::read_vector(bin.data, filename, bytes)) {
+		printf("Chart: Couldn't read %s\n", filename.c_str());
+		return false;
+	}
+	if (!bin.open(meta_only)) {
+		printf("Chart: %s isn't a chart we can read.\n", filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool load_chart(const std::string &filename, chart_t &chart, int which, metadata_t *meta) {
+	size_t dot = filename.find_last_of('.');
+	bool vbc = dot != std::string::npos && (
+		filename.compare(dot, std::string::npos, ".vbc") == 0 ||
+		filename.compare(dot, std::string::npos, ".VBC") == 0
+	);
+
+	if (vbc) {
+		binary_t bin;
+		if (!load_binary(filename, bin) || !bin.decode(uint32_t(which), chart)) {
+			return false;
+		}
+		if (meta) {
+			*meta = *bin.meta();
+		}
+		return true;
+	}
+
+	// too big for the stack.
+	song_t *song = new song_t();
+	bool ok = load_sm(filename, *song, &chart, which);
+	if (ok && meta) {
+		*meta = song->meta;
+	}
+	delete song;
+	return ok;
+}
+
+} // chart
+} // vbeat
@@ -0,0 +1,436 @@
+/* StepMania chart files are a list of #TAG:value; pairs, where value can
+ * hold colons (#NOTES has its fields split by them) and // starts a comment
+ * that runs to the end of the line. Everything here works on pointer
+ * ranges into the file buffer; nothing gets copied unless it's kept. */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "profiler.hpp"
+#include "chart/sm.hpp"
+
+namespace vbeat {
+namespace chart {
+
+namespace {
+	struct range_t {
+		const char *begin;
+		const char *end;
+
+		bool empty() const { return begin == end; }
+	};
+
+	bool is_space(char c) {
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+
+	range_t trim(range_t r) {
+		while (r.begin < r.end && is_space(*r.begin)) {
+			r.begin++;
+		}
+		while (r.end > r.begin && is_space(r.end[-1])) {
+			r.end--;
+		}
+		return r;
+	}
+
+	bool equals(range_t r, const char *s) {
+		size_t n = strlen(s);
+		if (size_t(r.end - r.begin) != n) {
+			return false;
+		}
+		for (size_t i = 0; i < n; i++) {
+			char c = r.begin[i];
+			if (c >= 'a' && c <= 'z') {
+				c -= 'a' - 'A';
+			}
+			if (c != s[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template <size_t N>
+	void copy(char (&dst)[N], range_t r) {
+		r = trim(r);
+		size_t n = size_t(r.end - r.begin);
+		n = n < N - 1 ? n : N - 1;
+		memcpy(dst, r.begin, n);
+		dst[n] = '\0';
+	}
+
+	/* strtod wants a terminator, and the range doesn't have one: the last
+	 * value in a file can run right up to the end of the buffer. Anything
+	 * longer than this isn't a number we'd get more out of anyway. */
+	double to_double(range_t r) {
+		r = trim(r);
+		char buf[64];
+		size_t n = size_t(r.end - r.begin);
+		n = n < sizeof(buf) - 1 ? n : sizeof(buf) - 1;
+		memcpy(buf, r.begin, n);
+		buf[n] = '\0';
+		return n == 0 ? 0.0 : strtod(buf, nullptr);
+	}
+
+	// Split off the next piece of r up to sep.
+	range_t next_field(range_t &r, char sep) {
+		range_t field = { r.begin, r.begin };
+		while (field.end < r.end && *field.end != sep) {
+			field.end++;
+		}
+		r.begin = field.end < r.end ? field.end + 1 : r.end;
+		return field;
+	}
+
+	// A line of note data, minus any comment on it.
+	range_t note_line(range_t &r) {
+		range_t line = next_field(r, '\n');
+		for (const char *c = line.begin; c + 1 < line.end; c++) {
+			if (c[0] == '/' && c[1] == '/') {
+				line.end = c;
+				break;
+			}
+		}
+		return trim(line);
+	}
+
+	/* beat=value,beat=value,... into whatever segment list; the callback
+	 * gets each pair. */
+	template <typename Fn>
+	void parse_pairs(range_t r, Fn fn) {
+		while (!r.empty()) {
+			range_t pair = next_field(r, ',');
+			range_t beat = next_field(pair, '=');
+			if (trim(beat).empty() || trim(pair).empty()) {
+				continue;
+			}
+			fn(to_double(beat), to_double(pair));
+		}
+	}
+
+	// The steps types we can play, and which bits their columns use.
+	int columns_for(range_t steps_type) {
+		steps_type = trim(steps_type);
+		if (equals(steps_type, "DANCE-SINGLE")) {
+			return 4;
+		}
+		if (equals(steps_type, "DANCE-SOLO")) {
+			return 6;
+		}
+		return 0;
+	}
+
+	/* Measures split by commas, rows by lines. A measure's rows split its
+	 * four beats evenly, so count them before handing out beats. */
+	void parse_notes(range_t r, int columns, chart_t &chart) {
+		// 4 columns use the middle bits, 6 all of them.
+		int first_bit = columns == 4 ? 1 : 0;
+
+		/* A line makes up to three rows: taps, hold heads and tails. Count
+		 * which of those each line could make, so it's one allocation and
+		 * done. Comments can only make this too big. */
+		size_t rows = 0;
+		uint8_t kinds = 0;
+		for (const char *p = r.begin; p < r.end; p++) {
+			switch (*p) {
+				case '1': kinds |= 1; break;
+				case '2':
+				case '4': kinds |= 2; break;
+				case '3': kinds |= 4; break;
+				case '\n':
+					rows += (kinds & 1) + ((kinds >> 1) & 1) + ((kinds >> 2) & 1);
+					kinds = 0;
+					break;
+				default: break;
+			}
+		}
+		rows += (kinds & 1) + ((kinds >> 1) & 1) + ((kinds >> 2) & 1);
+		chart.rows.reserve(chart.rows.size() + rows);
+
+		int measure = 0;
+		while (!r.empty()) {
+			range_t m = next_field(r, ',');
+
+			// count rows: lines with something on them
+			int num_rows = 0;
+			for (range_t lines = m; !lines.empty();) {
+				if (!note_line(lines).empty()) {
+					num_rows++;
+				}
+			}
+
+			int row = 0;
+			while (!m.empty()) {
+				range_t line = note_line(m);
+				if (line.empty()) {
+					continue;
+				}
+
+				uint8_t taps = 0, heads = 0, tails = 0;
+				int n = int(line.end - line.begin);
+				for (int c = 0; c < columns && c < n; c++) {
+					uint8_t bit = uint8_t(1 << (first_bit + c));
+					switch (line.begin[c]) {
+						case '1': taps  |= bit; break;
+						case '2':
+						case '4': heads |= bit; break; // rolls are holds to us
+						case '3': tails |= bit; break;
+						default: break; // mines, fakes, lifts, keysounds...
+					}
+				}
+
+				float beat = float(measure * 4) + 4.f * float(row) / float(num_rows);
+				if (taps) {
+					note_row_t nr = { beat, 0, taps };
+					chart.rows.push_back(nr);
+				}
+				if (heads) {
+					note_row_t nr = { beat, 0, uint8_t(heads | HOLD_HEAD) };
+					chart.rows.push_back(nr);
+				}
+				if (tails) {
+					note_row_t nr = { beat, 0, uint8_t(tails | HOLD_TAIL) };
+					chart.rows.push_back(nr);
+				}
+				row++;
+			}
+			measure++;
+		}
+	}
+
+	// Timing tags, wherever they show up.
+	bool parse_timing(range_t tag, range_t value, timing_t &timing) {
+		if (equals(tag, "OFFSET")) {
+			// the file has it backwards: it's how far into the music beat 0 isn't.
+			timing.offset = -to_double(value);
+		} else if (equals(tag, "BPMS")) {
+			parse_pairs(value, [&](double beat, double bpm) {
+				bpm_segment_t s = { beat, bpm };
+				timing.bpms.push_back(s);
+			});
+		} else if (equals(tag, "STOPS") || equals(tag, "FREEZES")) {
+			parse_pairs(value, [&](double beat, double seconds) {
+				stop_segment_t s = { beat, seconds, false };
+				timing.stops.push_back(s);
+			});
+		} else if (equals(tag, "DELAYS")) {
+			parse_pairs(value, [&](double beat, double seconds) {
+				stop_segment_t s = { beat, seconds, true };
+				timing.stops.push_back(s);
+			});
+		} else if (equals(tag, "SCROLLS")) {
+			parse_pairs(value, [&](double beat, double factor) {
+				scroll_segment_t s = { beat, factor };
+				timing.scrolls.push_back(s);
+			});
+		} else {
+			return false;
+		}
+		return true;
+	}
+
+	/* Which charts get their notes read: just `which` into chart, or with
+	 * which < 0, every one into charts[i]. */
+	struct targets_t {
+		chart_t *charts;
+		int      which;
+
+		chart_t *get(int index) const {
+			if (!this->charts || index < 0) {
+				return nullptr;
+			}
+			if (this->which < 0) {
+				return &this->charts[index];
+			}
+			return index == this->which ? this->charts : nullptr;
+		}
+	};
+
+	// Split timing (.ssc) gets filled in from the song's where it's missing.
+	void finish_chart(const song_t &song, chart_t &chart, bool own_timing, bool own_offset) {
+		if (!own_timing) {
+			chart.timing = song.timing;
+		} else {
+			// the editor always writes both, but fill in what's missing.
+			if (!own_offset) {
+				chart.timing.offset = song.timing.offset;
+			}
+			if (chart.timing.bpms.empty()) {
+				chart.timing.bpms = song.timing.bpms;
+			}
+		}
+		chart.timing.build();
+		chart.compute_times();
+		chart.sort();
+	}
+
+	void parse(const char *text, size_t size, bool ssc, song_t &song, const targets_t &targets) {
+		memset(&song.meta, 0, sizeof(song.meta));
+		memset(song.charts, 0, sizeof(song.charts));
+		song.num_charts = 0;
+		song.timing = timing_t();
+
+		for (int i = 0; i < song_t::max_charts; i++) {
+			chart_t *chart = targets.get(i);
+			if (chart) {
+				chart->rows.clear();
+				chart->timing = timing_t();
+			}
+		}
+		// did the charts we're loading bring their own?
+		bool chart_timing[song_t::max_charts] = {};
+		bool chart_offset[song_t::max_charts] = {};
+		int  current = -1; // chart the tags are about (.ssc)
+
+		const char *p   = text;
+		const char *end = text + size;
+		while (p < end) {
+			// find the next tag, skipping comments
+			if (*p == '/' && p + 1 < end && p[1] == '/') {
+				while (p < end && *p != '\n') {
+					p++;
+				}
+				continue;
+			}
+			if (*p != '#') {
+				p++;
+				continue;
+			}
+			p++;
+
+			range_t tag = { p, p };
+			while (tag.end < end && *tag.end != ':' && *tag.end != ';') {
+				tag.end++;
+			}
+			if (tag.end >= end || *tag.end == ';') {
+				p = tag.end;
+				continue;
+			}
+
+			// Values run to the ;. Comments inside them are only a thing in
+			// note data, and never have a ; in them in practice.
+			range_t value = { tag.end + 1, tag.end + 1 };
+			while (value.end < end && *value.end != ';') {
+				value.end++;
+			}
+			p = value.end < end ? value.end + 1 : end;
+
+			tag = trim(tag);
+			chart_t *target = targets.get(current);
+
+			// .ssc: each chart starts with #NOTEDATA and its tags follow.
+			if (ssc && equals(tag, "NOTEDATA")) {
+				if (song.num_charts < uint32_t(song_t::max_charts)) {
+					current = int(song.num_charts++);
+				} else {
+					current = -2; // past what we keep, ignore it
+				}
+				continue;
+			}
+
+			if (current == -1) {
+				metadata_t &m = song.meta;
+				if (equals(tag, "TITLE")) {
+					copy(m.title, value);
+				} else if (equals(tag, "SUBTITLE")) {
+					copy(m.subtitle, value);
+				} else if (equals(tag, "ARTIST")) {
+					copy(m.artist, value);
+				} else if (equals(tag, "CREDIT")) {
+					copy(m.credit, value);
+				} else if (equals(tag, "MUSIC")) {
+					copy(m.music, value);
+				} else if (equals(tag, "BANNER")) {
+					copy(m.banner, value);
+				} else if (equals(tag, "BACKGROUND")) {
+					copy(m.background, value);
+				} else if (equals(tag, "DISPLAYBPM")) {
+					copy(m.display_bpm, value);
+				} else if (equals(tag, "SAMPLESTART")) {
+					m.sample_start = to_double(value);
+				} else if (equals(tag, "SAMPLELENGTH")) {
+					m.sample_length = to_double(value);
+				} else if (parse_timing(tag, value, song.timing)) {
+					// done
+				} else if (!ssc && equals(tag, "NOTES")) {
+					// .sm: type:description:difficulty:meter:radar:notes
+					if (song.num_charts >= uint32_t(song_t::max_charts)) {
+						continue;
+					}
+					int index = int(song.num_charts++);
+					chart_info_t &info = song.charts[index];
+					range_t type = next_field(value, ':');
+					copy(info.steps_type, type);
+					copy(info.description, next_field(value, ':'));
+					copy(info.difficulty, next_field(value, ':'));
+					info.meter   = int32_t(to_double(next_field(value, ':')));
+					info.columns = columns_for(type);
+					next_field(value, ':'); // groove radar
+					chart_t *chart = targets.get(index);
+					if (chart && info.columns > 0) {
+						parse_notes(value, info.columns, *chart);
+					}
+				}
+				continue;
+			}
+
+			if (current < 0) {
+				continue;
+			}
+
+			chart_info_t &info = song.charts[current];
+			if (equals(tag, "STEPSTYPE")) {
+				copy(info.steps_type, value);
+				info.columns = columns_for(value);
+			} else if (equals(tag, "DIFFICULTY")) {
+				copy(info.difficulty, value);
+			} else if (equals(tag, "DESCRIPTION")) {
+				copy(info.description, value);
+			} else if (equals(tag, "METER")) {
+				info.meter = int32_t(to_double(value));
+			} else if (equals(tag, "NOTES")) {
+				if (target && info.columns > 0) {
+					parse_notes(value, info.columns, *target);
+				}
+			} else if (target) {
+				// split timing: any timing tag here means the chart has its own.
+				if (parse_timing(tag, value, target->timing)) {
+					chart_timing[current] = true;
+					chart_offset[current] |= equals(tag, "OFFSET");
+				}
+			}
+		}
+
+		song.timing.build();
+
+		for (uint32_t i = 0; i < song.num_charts; i++) {
+			chart_t *chart = targets.get(int(i));
+			if (chart && song.charts[i].columns > 0) {
+				finish_chart(song, *chart, chart_timing[i], chart_offset[i]);
+			}
+		}
+	}
+}
+
+bool parse_sm(const char *text, size_t size, bool ssc, song_t &song, chart_t *chart, int which) {
+	VBEAT_PROFILE_SCOPE("chart::parse_sm");
+	// a negative which would mean all of them to parse().
+	targets_t targets = { chart, which < 0 ? int(song_t::max_charts) : which };
+	parse(text, size, ssc, song, targets);
+
+	if (chart && (which < 0 || which >= int(song.num_charts) || song.charts[which].columns == 0)) {
+		return false;
+	}
+	return true;
+}
+
+void parse_sm_charts(const char *text, size_t size, bool ssc, song_t &song, chart_t *charts) {
+	VBEAT_PROFILE_SCOPE("chart::parse_sm_charts");
+	targets_t targets = { charts, -1 };
+	parse(text, size, ssc, song, targets);
+}
+
+} // chart
+} // vbeat
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "chart/chart.hpp"
+
+namespace vbeat {
+namespace chart {
+
+// What song select needs to know about a song. Fixed size, so it can be
+// copied around and written out as is.
+struct metadata_t {
+	char   title[128];
+	char   subtitle[128];
+	char   artist[128];
+	char   credit[64];
+	char   music[128];
+	char   banner[128];
+	char   background[128];
+	char   display_bpm[32];
+	double sample_start;
+	double sample_length;
+};
+
+struct chart_info_t {
+	char    steps_type[32];
+	char    difficulty[32];
+	char    description[64];
+	int32_t meter;
+	int32_t columns; // 0 if we can't play it
+};
+
+struct song_t {
+	enum {
+		max_charts = 32
+	};
+
+	metadata_t   meta;
+	timing_t     timing;
+	chart_info_t charts[max_charts];
+	uint32_t     num_charts;
+};
+
+/* StepMania .sm/.ssc. One pass over the text, straight out of the buffer:
+ * metadata and chart info go into song's fixed fields, timing into
+ * song.timing, and if `chart` is given, the notes of chart number `which`
+ * (counting every chart in the file) into it, with its own timing if it
+ * has some (.ssc), the song's otherwise.
+ *
+ * text doesn't have to be null terminated. */
+bool parse_sm(const char *text, size_t size, bool ssc, song_t &song, chart_t *chart = nullptr, int which = 0);
+
+/* The same pass, keeping every chart: charts is song_t::max_charts long and
+ * charts[i] gets chart i, for each one we can play. For going through all
+ * of a file without parsing it once per chart. */
+void parse_sm_charts(const char *text, size_t size, bool ssc, song_t &song, chart_t *charts);
+
+// Same, through the VFS; .ssc or .sm going by the extension. See chart/load.cpp.
+bool load_sm(const std::string &filename, song_t &song, chart_t *chart = nullptr, int which = 0);
+
+} // chart
+} // vbeat
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "chart/timing.hpp"
+
+namespace vbeat {
+namespace chart {
+
+namespace {
+	// Past this many keys, give up walking and binary search.
+	const size_t max_walk = 8;
+
+	// Last key with key.*field <= value (or key 0).
+	template <typename Key, typename Value>
+	size_t search(const std::vector<Key> &keys, double value, Value value_of) {
+		size_t lo = 0, hi = keys.size();
+		while (hi - lo > 1) {
+			size_t mid = lo + (hi - lo) / 2;
+			if (value_of(keys[mid]) <= value) {
+				lo = mid;
+			} else {
+				hi = mid;
+			}
+		}
+		return lo;
+	}
+
+	template <typename Key, typename Value>
+	size_t walk(const std::vector<Key> &keys, double value, size_t hint, Value value_of) {
+		if (hint >= keys.size() || value_of(keys[hint]) > value) {
+			return search(keys, value, value_of);
+		}
+		for (size_t steps = 0; hint + 1 < keys.size() && value_of(keys[hint + 1]) <= value; steps++) {
+			if (steps == max_walk) {
+				return search(keys, value, value_of);
+			}
+			hint++;
+		}
+		return hint;
+	}
+
+	template <typename T>
+	bool by_beat(const T &a, const T &b) {
+		return a.beat < b.beat;
+	}
+}
+
+void timing_t::build() {
+	std::stable_sort(this->bpms.begin(), this->bpms.end(), by_beat<bpm_segment_t>);
+	std::stable_sort(this->stops.begin(), this->stops.end(), by_beat<stop_segment_t>);
+	std::stable_sort(this->scrolls.begin(), this->scrolls.end(), by_beat<scroll_segment_t>);
+
+	// Time keys: one wherever the bpm changes or there's a stop, with the
+	// time summed up to there.
+	this->time_keys.clear();
+	time_key_t key;
+	key.beat        = 0.0;
+	if (!this->bpms.empty() && this->bpms[0].beat < key.beat) {
+		key.beat = this->bpms[0].beat;
+	}
+	if (!this->stops.empty() && this->stops[0].beat < key.beat) {
+		key.beat = this->stops[0].beat;
+	}
+	key.spb         = 60.0 / (this->bpms.empty() || this->bpms[0].bpm <= 0.0 ? 60.0 : this->bpms[0].bpm);
+	key.time        = this->offset + key.beat * key.spb;
+	key.pause       = 0.0;
+	key.delay_pause = 0.0;
+	this->time_keys.push_back(key);
+
+	size_t b = 0, s = 0;
+	while (b < this->bpms.size() || s < this->stops.size()) {
+		double next_bpm  = b < this->bpms.size()  ? this->bpms[b].beat  : 1e300;
+		double next_stop = s < this->stops.size() ? this->stops[s].beat : 1e300;
+		double beat = next_bpm < next_stop ? next_bpm : next_stop;
+
+		time_key_t &last = this->time_keys.back();
+		if (beat > last.beat) {
+			time_key_t k = last;
+			k.time        = last.time + last.pause + (beat - last.beat) * last.spb;
+			k.beat        = beat;
+			k.pause       = 0.0;
+			k.delay_pause = 0.0;
+			this->time_keys.push_back(k);
+		}
+
+		time_key_t &cur = this->time_keys.back();
+		while (b < this->bpms.size() && this->bpms[b].beat == beat) {
+			double bpm = this->bpms[b].bpm;
+			if (bpm <= 0.0) {
+				// negative bpms are a warp hack; we don't do warps.
+				printf("Timing: Ignoring bpm %f at beat %f.\n", bpm, beat);
+			} else {
+				cur.spb = 60.0 / bpm;
+			}
+			b++;
+		}
+		while (s < this->stops.size() && this->stops[s].beat == beat) {
+			double len = this->stops[s].seconds > 0.0 ? this->stops[s].seconds : 0.0;
+			cur.pause += len;
+			if (this->stops[s].delay) {
+				cur.delay_pause += len;
+			}
+			s++;
+		}
+	}
+
+	// Scroll keys, the same idea with position in place of time.
+	this->scroll_keys.clear();
+	scroll_key_t sk;
+	sk.beat   = 0.0;
+	sk.pos    = 0.0;
+	sk.factor = 1.0;
+	this->scroll_keys.push_back(sk);
+	for (auto &seg : this->scrolls) {
+		double factor = seg.factor;
+		if (factor < 0.0) {
+			printf("Timing: Negative scroll %f at beat %f, using 0.\n", factor, seg.beat);
+			factor = 0.0;
+		}
+		scroll_key_t &last = this->scroll_keys.back();
+		if (seg.beat > last.beat) {
+			scroll_key_t k;
+			k.beat   = seg.beat;
+			k.pos    = last.pos + (seg.beat - last.beat) * last.factor;
+			k.factor = factor;
+			this->scroll_keys.push_back(k);
+		} else {
+			last.factor = factor;
+		}
+	}
+}
+
+double timing_t::beat_to_time(double beat) const {
+	size_t hint = this->time_keys.size();
+	return this->beat_to_time(beat, hint);
+}
+
+double timing_t::time_to_beat(double time) const {
+	size_t hint = this->time_keys.size();
+	return this->time_to_beat(time, hint);
+}
+
+double timing_t::beat_to_scroll(double beat) const {
+	size_t hint = this->scroll_keys.size();
+	return this->beat_to_scroll(beat, hint);
+}
+
+double timing_t::beat_to_time(double beat, size_t &hint) const {
+	hint = walk(this->time_keys, beat, hint, [](const time_key_t &k) { return k.beat; });
+	const time_key_t &k = this->time_keys[hint];
+	// before beat 0 it just keeps going at the first bpm.
+	if (beat == k.beat) {
+		return k.time + k.delay_pause;
+	}
+	double pause = beat > k.beat ? k.pause : 0.0;
+	return k.time + pause + (beat - k.beat) * k.spb;
+}
+
+double timing_t::time_to_beat(double time, size_t &hint) const {
+	hint = walk(this->time_keys, time, hint, [](const time_key_t &k) { return k.time; });
+	const time_key_t &k = this->time_keys[hint];
+	double t = time - k.time;
+	if (t < 0.0) {
+		return k.beat + t / k.spb;
+	}
+	if (t < k.pause) {
+		return k.beat;
+	}
+	return k.beat + (t - k.pause) / k.spb;
+}
+
+double timing_t::beat_to_scroll(double beat, size_t &hint) const {
+	hint = walk(this->scroll_keys, beat, hint, [](const scroll_key_t &k) { return k.beat; });
+	const scroll_key_t &k = this->scroll_keys[hint];
+	// before beat 0, factor 1
+	if (beat < k.beat) {
+		return k.pos + (beat - k.beat);
+	}
+	return k.pos + (beat - k.beat) * k.factor;
+}
+
+double timing_t::scroll_to_beat(double pos) const {
+	size_t i = search(this->scroll_keys, pos, [](const scroll_key_t &k) { return k.pos; });
+	// several keys can share a pos when the scroll stands still; take the last.
+	while (i + 1 < this->scroll_keys.size() && this->scroll_keys[i + 1].pos <= pos) {
+		i++;
+	}
+	const scroll_key_t &k = this->scroll_keys[i];
+	if (pos < k.pos) {
+		return k.beat + (pos - k.pos);
+	}
+	if (k.factor <= 0.0) {
+		// stands still from here on
+		return i + 1 < this->scroll_keys.size() ? this->scroll_keys[i + 1].beat : 1e300;
+	}
+	return k.beat + (pos - k.pos) / k.factor;
+}
+
+void timing_t::beats_to_times(const double *beats, double *out, size_t count) const {
+	size_t hint = 0;
+	for (size_t i = 0; i < count; i++) {
+		out[i] = this->beat_to_time(beats[i], hint);
+	}
+}
+
+void timing_t::beats_to_scroll(const double *beats, double *out, size_t count) const {
+	size_t hint = 0;
+	for (size_t i = 0; i < count; i++) {
+		out[i] = this->beat_to_scroll(beats[i], hint);
+	}
+}
+
+} // chart
+} // vbeat
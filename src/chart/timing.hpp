@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace vbeat {
+namespace chart {
+
+struct bpm_segment_t {
+	double beat;
+	double bpm;
+};
+
+/* The chart holds still for a while. A stop happens after notes on its beat
+ * (so they're hit before it), a delay before them. */
+struct stop_segment_t {
+	double beat;
+	double seconds;
+	bool   delay;
+};
+
+// From beat on, notes scroll at factor times the usual speed. Can't be < 0.
+struct scroll_segment_t {
+	double beat;
+	double factor;
+};
+
+/* Maps between song time, beats and scroll position (how far along the
+ * notes have moved, in beats at factor 1).
+ *
+ * build() turns the segments into two lists of keys with everything summed
+ * up to each one, so a lookup is a binary search and some arithmetic. The
+ * versions that take a hint walk from where the last lookup ended up
+ * instead, which is O(1) when the values only move forward a bit at a
+ * time, like per tick or down a sorted list of notes. */
+struct timing_t {
+	timing_t(): offset(0.0) {}
+
+	// Song time of beat 0, in seconds.
+	double offset;
+
+	std::vector<bpm_segment_t>    bpms;
+	std::vector<stop_segment_t>   stops;
+	std::vector<scroll_segment_t> scrolls;
+
+	// Call after changing any of the above. Sorts them, too.
+	void build();
+
+	double beat_to_time(double beat) const;
+	double time_to_beat(double time) const;
+	double beat_to_scroll(double beat) const;
+
+	// Beat where the scroll first reaches pos (the end of it, if it stands
+	// still there), for finding what's on screen.
+	double scroll_to_beat(double pos) const;
+
+	double beat_to_time(double beat, size_t &hint) const;
+	double time_to_beat(double time, size_t &hint) const;
+	double beat_to_scroll(double beat, size_t &hint) const;
+
+	/* A whole list at once, e.g. every note in the chart; fastest when the
+	 * input is sorted. out can be the same array as in. */
+	void beats_to_times(const double *beats, double *out, size_t count) const;
+	void beats_to_scroll(const double *beats, double *out, size_t count) const;
+
+private:
+	// Time from beat to beat + 1 is spb seconds, after waiting `pause`
+	// seconds at beat (delay_pause of which come before notes on it).
+	struct time_key_t {
+		double beat;
+		double time;
+		double spb;
+		double pause;
+		double delay_pause;
+	};
+
+	struct scroll_key_t {
+		double beat;
+		double pos;
+		double factor;
+	};
+
+	std::vector<time_key_t>   time_keys;
+	std::vector<scroll_key_t> scroll_keys;
+};
+
+} // chart
+} // vbeat
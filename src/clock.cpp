@@ -0,0 +1,44 @@
+#include <SDL2/SDL_timer.h>
+
+#include "clock.hpp"
+
+namespace vbeat {
+namespace clock {
+
+namespace {
+	uint64_t epoch = 0;
+	uint64_t freq  = 1;
+}
+
+void init() {
+	freq  = SDL_GetPerformanceFrequency();
+	epoch = SDL_GetPerformanceCounter();
+}
+
+uint64_t now() {
+	return SDL_GetPerformanceCounter() - epoch;
+}
+
+uint64_t frequency() {
+	return freq;
+}
+
+double to_seconds(uint64_t counter) {
+	return double(counter / freq) + double(counter % freq) / double(freq);
+}
+
+uint64_t to_ticks(uint64_t counter, uint64_t rate) {
+	// split so counter * rate can't overflow.
+	return (counter / freq) * rate + (counter % freq) * rate / freq;
+}
+
+uint64_t from_ticks(uint64_t ticks, uint64_t rate) {
+	return (ticks / rate) * freq + (ticks % rate) * freq / rate;
+}
+
+double tick_fraction(uint64_t counter, uint64_t rate) {
+	return double((counter % freq) * rate % freq) / double(freq);
+}
+
+} // clock
+} // vbeat
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+namespace vbeat {
+namespace clock {
+	// Record the epoch everything else is measured from.
+	void init();
+
+	// Performance counter ticks since init(), and how many there are per second.
+	uint64_t now();
+	uint64_t frequency();
+
+	double to_seconds(uint64_t counter);
+
+	// Whole ticks of a fixed-rate clock contained in counter, and how far
+	// into the next one we are [0, 1). Integer math, so nothing drifts.
+	uint64_t to_ticks(uint64_t counter, uint64_t rate);
+	double   tick_fraction(uint64_t counter, uint64_t rate);
+
+	// Counter value at the start of a tick.
+	uint64_t from_ticks(uint64_t ticks, uint64_t rate);
+} // clock
+} // vbeat
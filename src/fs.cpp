@@ -5,8 +5,9 @@
 
 #include "vbeat.hpp"
 #include "fs.hpp"
+#include "profiler.hpp"
+#include "hitch.hpp"
 #include <physfs.h>
-#include <bgfx/bgfx.h>
 #include <SDL2/SDL_assert.h>
 #include <bx/readerwriter.h>
 #include <bx/platform.h>
@@ -76,6 +77,7 @@ struct FileReader_PhysFS : public bx::FileReaderI {
 			return false;
 		}
 
+		hitch::count(hitch::counter::files_opened, filename);
 		::files_open += 1;
 		return true;
 	}
@@ -186,6 +188,9 @@ void fs::init(const char *argv0) {
 void fs::deinit() {
 	PHYSFS_deinit();
 	printf("VFS: Shutting down (%d remaining file handles).\n", ::files_open);
+#if VBEAT_HEAP_TRACKING
+	v_heap_report();
+#endif
 }
 
 bool fs::is_fused() {
@@ -213,8 +218,24 @@ bool fs::is_file(const std::string &filename) {
 	return false;
 }
 
+bool fs::stat(const std::string &filename, stat_t &st) {
+	PHYSFS_Stat stat;
+	if (!PHYSFS_stat(filename.c_str(), &stat)) {
+		return false;
+	}
+	st.size   = stat.filesize;
+	st.mtime  = stat.modtime;
+	st.is_dir = stat.filetype == PHYSFS_FILETYPE_DIRECTORY;
+	return true;
+}
+
 void fs::get_directory_items(std::vector<std::string> &items, const std::string &path, bool check_read) {
-	char **files = PHYSFS_enumerateFiles(path.c_str());
+	VBEAT_ALLOC_TAG(fs);
+	char **list  = PHYSFS_enumerateFiles(path.c_str());
+	if (!list) {
+		return;
+	}
+	char **files = list;
 	PHYSFS_File *f = NULL;
 	while (*files) {
 		const char *fname = *files;
@@ -232,13 +253,16 @@ void fs::get_directory_items(std::vector<std::string> &items, const std::string
 			f = NULL;
 		}
 	}
+	PHYSFS_freeList(list);
 }
 
 bool fs::read_string(std::string &data, const std::string &filename, int bytes) {
+	VBEAT_PROFILE_SCOPE("fs::read_string");
+	VBEAT_ALLOC_TAG(fs);
 	auto file = FileReader_PhysFS();
 	if (bx::open(&file, filename.c_str())) {
 		int32_t _size = (int32_t)bx::getSize(&file);
-		int32_t _read = bytes > 0 ? bytes : _size;
+		int32_t _read = bytes > 0 && bytes < _size ? bytes : _size;
 		data.resize(_read+1);
 		bx::read(&file, &data[0], _read);
 		data[_read] = '\0';
@@ -250,10 +274,12 @@ bool fs::read_string(std::string &data, const std::string &filename, int bytes)
 }
 
 bool fs::read_vector(std::vector<uint8_t> &data, const std::string &filename, int bytes) {
+	VBEAT_PROFILE_SCOPE("fs::read_vector");
+	VBEAT_ALLOC_TAG(fs);
 	auto file = FileReader_PhysFS();
 	if (bx::open(&file, filename.c_str())) {
 		int32_t _size = (int32_t)bx::getSize(&file);
-		int32_t _read = bytes > 0 ? bytes : _size;
+		int32_t _read = bytes > 0 && bytes < _size ? bytes : _size;
 		data.resize(_read);
 		bx::read(&file, &data[0], _read);
 		bx::close(&file);
@@ -262,20 +288,30 @@ bool fs::read_vector(std::vector<uint8_t> &data, const std::string &filename, in
 	return false;
 }
 
-const bgfx::Memory *fs::read_mem(const std::string &filename, int bytes) {
-	auto file = FileReader_PhysFS();
+bool fs::write(const std::string &filename, const std::string &data, int bytes) {
+	auto file = FileWriter_PhysFS();
 	if (bx::open(&file, filename.c_str())) {
-		int32_t _size = (int32_t)bx::getSize(&file);
-		int32_t _read = bytes > 0 ? bytes : _size;
-		const bgfx::Memory* buf = bgfx::alloc(_size);
-		bx::read(&file, buf->data, _read);
+		int32_t _size  = (int32_t)data.size();
+		int32_t _write = bytes > 0 && bytes < _size ? bytes : _size;
+		bx::Error err;
+		bx::write(&file, data.data(), _write, &err);
 		bx::close(&file);
+		return err.isOk();
+	}
+	return false;
+}
 
-		return buf;
+bool fs::append(const std::string &filename, const void *data, size_t size) {
+	auto file = FileWriter_PhysFS();
+	bx::Error err;
+	if (!bx::open(&file, filename.c_str(), true, &err)) {
+		return false;
 	}
-	return bgfx::makeRef(NULL, 0);
+	bx::write(&file, data, int32_t(size), &err);
+	bx::close(&file);
+	return err.isOk();
 }
 
-bool fs::write(const std::string &, const std::string &, int) {
-	return false;
+bool fs::make_dir(const std::string &path) {
+	return PHYSFS_mkdir(path.c_str()) != 0;
 }
@@ -4,8 +4,6 @@
 #include <vector>
 #include <cstdint>
 
-namespace bgfx { struct Memory; }
-
 struct lua_State;
 
 namespace vbeat {
@@ -20,6 +18,15 @@ namespace fs {
 	// Check that a given file is a file (i.e. not a directory).
 	bool is_file(const std::string &filename);
 
+	struct stat_t {
+		int64_t size;
+		int64_t mtime; // seconds, -1 if the archive doesn't know
+		bool    is_dir;
+	};
+
+	// Size and modification time of a file or directory, false if it isn't there.
+	bool stat(const std::string &filename, stat_t &st);
+
 	// Get the physical path of a file in the VFS.
 	std::string get_real_path(const std::string &filename);
 
@@ -29,15 +36,18 @@ namespace fs {
 	// Read file contents into string.
 	bool read_string(std::string &data, const std::string &filename, int bytes = -1);
 
-	// Read file contents into vector.
+	// Read file contents into vector. bytes > 0 reads at most that much.
 	bool read_vector(std::vector<uint8_t> &data, const std::string &filename, int bytes = -1);
 
-	// Read file into a buffer for BGFX, or nullptr.
-	const bgfx::Memory *read_mem(const std::string &filename, int bytes = -1);
-
 	// Write string contents to file.
 	bool write(const std::string &filename, const std::string &data, int bytes = -1);
 
+	// Tack bytes onto the end of a file, creating it if need be.
+	bool append(const std::string &filename, const void *data, size_t size);
+
+	// Make a directory (and any parents) in the write dir.
+	bool make_dir(const std::string &path);
+
 	struct state {
 		state(const char *argv0) { fs::init(argv0); }
 		virtual ~state() { fs::deinit(); }
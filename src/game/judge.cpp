@@ -0,0 +1,166 @@
+#include "game/judge.hpp"
+
+namespace vbeat {
+namespace game {
+
+// Extends the old good = 200, great = 50.
+const int32_t tier_windows[tier::miss] = {
+	25,  // perfect
+	50,  // great
+	200  // good
+};
+
+const char *tier_name(tier::Enum t) {
+	static const char *names[tier::count] = {
+		"perfect",
+		"great",
+		"good",
+		"miss"
+	};
+	return t < tier::count ? names[t] : "?";
+}
+
+void judge_t::reset(const chart::chart_t *_chart) {
+	this->chart    = _chart;
+	this->next_row = 0;
+	this->now      = INT64_MIN;
+	this->dropped  = 0;
+	for (int i = 0; i < max_lanes; i++) {
+		this->lanes[i].clear();
+	}
+	this->results.clear();
+}
+
+void judge_t::seek(int64_t t) {
+	this->next_row = this->chart->lower_bound(t);
+	this->now      = t - 1; // so advance(t) still queues what's at t
+	for (int i = 0; i < max_lanes; i++) {
+		this->lanes[i].clear();
+	}
+	this->results.clear();
+}
+
+void judge_t::emit(const judgment_t &j) {
+	if (!this->results.push(j)) {
+		this->dropped += 1;
+	}
+}
+
+void judge_t::miss_front(int lane) {
+	pending_t &p = this->lanes[lane][0];
+	if (!p.judged) {
+		judgment_t j;
+		j.row    = p.row;
+		j.lane   = uint8_t(lane);
+		j.tier   = tier::miss;
+		j.offset = 0;
+		j.time   = this->now;
+		this->emit(j);
+	}
+	this->lanes[lane].pop();
+}
+
+void judge_t::advance(int64_t t) {
+	if (t <= this->now) {
+		return;
+	}
+	this->now = t;
+
+	const int64_t window = tier_windows[tier::good];
+
+	// Queue up anything the front of the window reached.
+	const std::vector<chart::note_row_t> &rows = this->chart->rows;
+	while (this->next_row < rows.size() && int64_t(rows[this->next_row].ms) <= t + window) {
+		const chart::note_row_t &row = rows[this->next_row];
+		// hold ends aren't hit, and holds are judged on the way down for now.
+		if (row.columns & chart::HOLD_TAIL) {
+			this->next_row += 1;
+			continue;
+		}
+		for (int lane = 0; lane < max_lanes; lane++) {
+			if (!((row.columns >> lane) & 0x1)) {
+				continue;
+			}
+			pending_t p = { uint32_t(this->next_row), row.ms, false };
+			// Only if someone wrote a chart with 64 notes in 400ms.
+			if (this->lanes[lane].size() == lane_queue) {
+				this->miss_front(lane);
+			}
+			this->lanes[lane].push(p);
+		}
+		this->next_row += 1;
+	}
+
+	// Whatever went past the back of the window is a miss.
+	for (int lane = 0; lane < max_lanes; lane++) {
+		auto &q = this->lanes[lane];
+		while (!q.empty() && int64_t(q[0].ms) < t - window) {
+			this->miss_front(lane);
+		}
+	}
+}
+
+bool judge_t::press(int lane, int64_t t) {
+	this->advance(t);
+
+	if (lane < 0 || lane >= max_lanes) {
+		return false;
+	}
+
+	// Sorted by time, so the distance shrinks until the nearest note and
+	// grows after; stop as soon as it grows.
+	auto &q = this->lanes[lane];
+	int32_t best = -1;
+	int64_t best_dist = INT64_MAX;
+	for (uint32_t i = 0; i < q.size(); i++) {
+		if (q[i].judged) {
+			continue;
+		}
+		int64_t d = int64_t(q[i].ms) - t;
+		d = d < 0 ? -d : d;
+		if (d >= best_dist) {
+			break;
+		}
+		best = int32_t(i);
+		best_dist = d;
+	}
+	if (best < 0 || best_dist > tier_windows[tier::good]) {
+		return false;
+	}
+
+	pending_t &p = q[uint32_t(best)];
+	p.judged = true;
+
+	judgment_t j;
+	j.row    = p.row;
+	j.lane   = uint8_t(lane);
+	j.tier   = tier::good;
+	j.offset = int16_t(int64_t(p.ms) - t);
+	j.time   = t;
+	for (int i = 0; i < tier::miss; i++) {
+		if (best_dist <= tier_windows[i]) {
+			j.tier = uint8_t(i);
+			break;
+		}
+	}
+	this->emit(j);
+
+	// Judged notes at the front are done with.
+	while (!q.empty() && q[0].judged) {
+		q.pop();
+	}
+
+	return true;
+}
+
+bool judge_t::next(judgment_t &j) {
+	if (this->results.empty()) {
+		return false;
+	}
+	j = this->results[0];
+	this->results.pop();
+	return true;
+}
+
+} // game
+} // vbeat
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+
+#include "chart/chart.hpp"
+#include "ring.hpp"
+
+namespace vbeat {
+namespace game {
+
+struct tier {
+	enum Enum {
+		perfect,
+		great,
+		good,
+		miss,
+		count
+	};
+};
+
+// Widest |offset| in ms that still gets each tier. good is the whole window.
+extern const int32_t tier_windows[tier::miss];
+
+const char *tier_name(tier::Enum t);
+
+struct judgment_t {
+	uint32_t row;
+	uint8_t  lane;
+	uint8_t  tier;
+	int16_t  offset; // note time - hit time in ms, so early is positive. 0 for misses.
+	int64_t  time;   // when it was decided, song ms
+};
+
+/* Decides hits and misses. Doesn't know about widgets or input devices:
+ * feed it song times in order and it hands back judgments.
+ *
+ * Each lane keeps a small queue of the notes close enough to hit, oldest
+ * first. Notes get queued as the window reaches them and leave from the
+ * front, so a press only has to look at a handful of notes. */
+struct judge_t {
+	enum {
+		max_lanes  = 6,
+		lane_queue = 64,
+		max_results = 256
+	};
+
+	judge_t(): chart(nullptr), next_row(0), now(INT64_MIN), dropped(0) {}
+
+	void reset(const chart::chart_t *_chart);
+
+	/* Start over from song ms t, as if the song began there: nothing's
+	 * queued, and notes before t are skipped rather than missed. Binary
+	 * searches the chart, so it costs the same from anywhere. */
+	void seek(int64_t t);
+
+	/* Bring the judge up to song ms t: queue notes entering the window and
+	 * miss the ones that left it without being hit. Earlier times than last
+	 * time are ignored. */
+	void advance(int64_t t);
+
+	/* A lane went down at t. Judges the nearest unjudged note in that lane;
+	 * false if there wasn't one in reach. Calls advance(t) first. */
+	bool press(int lane, int64_t t);
+
+	// Take the oldest judgment made so far.
+	bool next(judgment_t &j);
+
+	// Judgments lost because nobody was taking them.
+	uint32_t dropped_results() const { return dropped; }
+
+private:
+	struct pending_t {
+		uint32_t row;
+		uint32_t ms;
+		bool     judged;
+	};
+
+	void emit(const judgment_t &j);
+	void miss_front(int lane);
+
+	const chart::chart_t *chart;
+	size_t  next_row; // first row not queued yet
+	int64_t now;
+
+	ring_t<pending_t, lane_queue> lanes[max_lanes];
+	ring_t<judgment_t, max_results> results;
+	uint32_t dropped;
+};
+
+} // game
+} // vbeat
@@ -0,0 +1,113 @@
+#include <cmath>
+
+#include "vbeat.hpp"
+#include "game/practice.hpp"
+
+namespace vbeat {
+namespace game {
+
+void practice_t::reset(session_t *_session) {
+	this->session = _session;
+	const chart::chart_t &chart = *_session->chart;
+	uint32_t last = chart.rows.empty() ? 0 : chart.rows.back().ms;
+
+	// one past the last note, so there's always a checkpoint to stop at.
+	size_t count = size_t(last / checkpoint_ms) + 2;
+	this->checkpoints.resize(count);
+	this->taken.assign(count, 0);
+	this->next       = 0;
+	this->looping    = false;
+	this->loop_ready = false;
+}
+
+uint32_t practice_t::index(double t) const {
+	double k = floor(t * 1000.0 / double(checkpoint_ms));
+	k = k < 0.0 ? 0.0 : k;
+	double top = double(this->checkpoints.size() - 1);
+	return uint32_t(k < top ? k : top);
+}
+
+void practice_t::update() {
+	session_t &s = *this->session;
+
+	// at most one a tick; a tick is a lot shorter than checkpoint_ms.
+	if (this->next < this->checkpoints.size() && s.time * 1000.0 >= double(this->next) * checkpoint_ms) {
+		s.save(this->checkpoints[this->next]);
+		this->taken[this->next] = 1;
+		this->next += 1;
+	}
+
+	if (!this->looping) {
+		return;
+	}
+	if (!this->loop_ready && s.time >= this->loop_from) {
+		s.save(this->loop_start);
+		this->loop_ready = true;
+	}
+	if (s.time >= this->loop_to) {
+		if (!this->loop_ready) {
+			this->seek(this->loop_from);
+			return;
+		}
+		s.restore(this->loop_start);
+		// the checkpoints inside the loop get taken again on the way round.
+		uint32_t k = this->index(this->loop_from) + 1;
+		this->next = this->next < k ? this->next : k;
+	}
+}
+
+void practice_t::seek(double t) {
+	session_t &s = *this->session;
+	uint32_t k = this->index(t);
+
+	if (t >= s.time) {
+		/* Forward: the score stands as it is, the notes in between just
+		 * aren't played. Checkpoints we jump over weren't taken this run,
+		 * whatever's left in them from before. */
+		for (uint32_t i = this->next; i <= k; i++) {
+			this->taken[i] = 0;
+		}
+		s.seek(t);
+		this->next = this->next > k + 1 ? this->next : k + 1;
+		return;
+	}
+
+	// Back: the last checkpoint this run took before t.
+	uint32_t last = this->next < k + 1 ? this->next : k + 1;
+	while (last > 0 && (!this->taken[last - 1] || this->checkpoints[last - 1].time > t)) {
+		last -= 1;
+	}
+	if (last > 0) {
+		s.restore(this->checkpoints[last - 1]);
+	} else {
+		s.stats.reset();
+	}
+	s.seek(t);
+
+	// anything after here is from a future that didn't happen now.
+	this->next = last;
+	if (this->loop_ready && t < this->loop_from) {
+		this->loop_ready = false;
+	}
+}
+
+void practice_t::set_loop(double from, double to) {
+	if (to <= from) {
+		return;
+	}
+	this->looping    = true;
+	this->loop_ready = false;
+	this->loop_from  = from;
+	this->loop_to    = to;
+	if (this->session->time > from) {
+		this->seek(from);
+	}
+}
+
+void practice_t::clear_loop() {
+	this->looping    = false;
+	this->loop_ready = false;
+}
+
+} // game
+} // vbeat
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "game/session.hpp"
+
+namespace vbeat {
+namespace game {
+
+/* Seeking, section loops and rate changes on top of a session.
+ *
+ * As the song plays, the session gets snapshotted every checkpoint_ms of
+ * song time. Seeking back restores the closest one before the target and
+ * starts the judge over from there, so the score is what it was at that
+ * point without running the song again. A loop takes its own snapshot as
+ * it's entered, and going round is just restoring it. */
+struct practice_t {
+	enum {
+		checkpoint_ms = 5000
+	};
+
+	practice_t(): session(nullptr), next(0), looping(false), loop_ready(false) {}
+
+	// Forget everything, for a session that was just reset. Sizes the
+	// checkpoints for its chart; the only place this allocates.
+	void reset(session_t *_session);
+
+	// After every tick: checkpoints, and back round if we're past the loop.
+	void update();
+
+	// To song time t, by way of the last checkpoint before it.
+	void seek(double t);
+
+	// Loop [from, to) until clear_loop(). Goes back to from if it's behind
+	// us. Does nothing if to isn't after from.
+	void set_loop(double from, double to);
+	void clear_loop();
+
+	session_t *session;
+
+	// checkpoints[k] is the session at song time k * checkpoint_ms. Only
+	// the ones before next with taken set belong to this run.
+	std::vector<session_t::snapshot_t> checkpoints;
+	std::vector<uint8_t> taken;
+	uint32_t next;
+
+	bool   looping;
+	bool   loop_ready; // loop_start holds the session at loop_from
+	double loop_from, loop_to;
+	session_t::snapshot_t loop_start;
+
+private:
+	// Checkpoint a time falls in, clamped to the ones we have.
+	uint32_t index(double t) const;
+};
+
+} // game
+} // vbeat
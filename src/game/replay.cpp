@@ -0,0 +1,135 @@
+#include <cstdio>
+#include <cstring>
+
+#include "vbeat.hpp"
+#include "fs.hpp"
+#include "version.hpp"
+#include "game/judge.hpp"
+#include "game/replay.hpp"
+
+namespace vbeat {
+namespace game {
+
+void init_header(replay_header_t &h, uint64_t chart, uint32_t tick_rate) {
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, "VBRP", 4);
+	h.version   = REPLAY_VERSION;
+	h.chart     = chart;
+	h.tick_rate = tick_rate;
+	strncpy(h.build, build_id(), sizeof(h.build) - 1);
+	for (int i = 0; i < tier::miss; i++) {
+		h.windows[i] = tier_windows[i];
+	}
+	h.rate  = 1.f;
+	h.speed = 1.f;
+}
+
+bool replay_writer_t::open(const std::string &_filename, const replay_header_t &header) {
+	this->close();
+	this->filename = _filename;
+	this->count    = 0;
+	this->dropped  = 0;
+	this->gap      = 0;
+	if (!fs::write(this->filename, std::string((const char*)&header, sizeof(header)))) {
+		printf("Replay: Couldn't start %s.\n", this->filename.c_str());
+		return false;
+	}
+	this->active = true;
+	return true;
+}
+
+void replay_writer_t::record(const replay_event_t &e) {
+	if (!this->active) {
+		return;
+	}
+	if (this->count == capacity) {
+		if (this->gap == 0) {
+			this->gap_tick = e.tick;
+		}
+		this->gap     += 1;
+		this->dropped += 1;
+		return;
+	}
+	this->pending[this->count++] = e;
+}
+
+bool replay_writer_t::flush(bool force) {
+	if (!this->active || (this->count == 0 && this->gap == 0)) {
+		return true;
+	}
+	if (!force && this->count < batch && this->gap == 0) {
+		return true;
+	}
+	bool ok = fs::append(this->filename, this->pending, this->count * sizeof(replay_event_t));
+
+	// the lost events came after everything that was buffered.
+	if (this->gap > 0) {
+		replay_event_t g;
+		g.tick   = this->gap_tick;
+		g.ms     = int32_t(this->gap);
+		g.lane   = 0;
+		g.type   = REPLAY_GAP;
+		g.unused = 0;
+		ok = fs::append(this->filename, &g, sizeof(g)) && ok;
+	}
+	if (!ok) {
+		printf("Replay: Couldn't write to %s.\n", this->filename.c_str());
+	}
+	this->count = 0;
+	this->gap   = 0;
+	return ok;
+}
+
+void replay_writer_t::close() {
+	if (!this->active) {
+		return;
+	}
+	this->flush(true);
+	this->active = false;
+	if (this->dropped > 0) {
+		printf("Replay: %u events didn't make it into %s, it's marked incomplete.\n", this->dropped, this->filename.c_str());
+	}
+}
+
+bool replay_t::parse(const uint8_t *data, size_t size) {
+	this->events.clear();
+	this->missing = 0;
+	if (size < sizeof(replay_header_t)) {
+		return false;
+	}
+	memcpy(&this->header, data, sizeof(replay_header_t));
+	if (memcmp(this->header.magic, "VBRP", 4) != 0) {
+		return false;
+	}
+	if (this->header.version != REPLAY_VERSION) {
+		printf("Replay: Version %u, want %u.\n", this->header.version, unsigned(REPLAY_VERSION));
+		return false;
+	}
+	// the build field is ours to print, make sure it ends.
+	this->header.build[sizeof(this->header.build) - 1] = '\0';
+
+	size_t n = (size - sizeof(replay_header_t)) / sizeof(replay_event_t);
+	const replay_event_t *events = (const replay_event_t*)(data + sizeof(replay_header_t));
+	this->events.reserve(n);
+	for (size_t i = 0; i < n; i++) {
+		if (events[i].type == REPLAY_GAP) {
+			this->missing += events[i].ms > 0 ? uint32_t(events[i].ms) : 1;
+			continue;
+		}
+		this->events.push_back(events[i]);
+	}
+	return true;
+}
+
+bool replay_t::load(const std::string &filename) {
+	VBEAT_ALLOC_TAG(general);
+	std::vector<uint8_t> data;
+	if (!fs::read_vector(data, filename)) {
+		printf("Replay: Couldn't read %s.\n", filename.c_str());
+		return false;
+	}
+	return this->parse(data.data(), data.size());
+}
+
+} // game
+} // vbeat
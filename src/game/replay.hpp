@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vbeat {
+namespace game {
+
+/* .vbr: a header, then input events one after another until the end of the
+ * file. Nothing refers forward, so it can be written as it happens and a
+ * file cut short still plays back up to where it stops. */
+enum {
+	REPLAY_VERSION = 1
+};
+
+struct replay_header_t {
+	char     magic[4]; // "VBRP"
+	uint32_t version;
+	uint64_t chart;    // chart_t::hash
+	char     build[32];
+
+	// what it was played with; these change the result.
+	uint32_t tick_rate;
+	int32_t  windows[3]; // tier_windows, ms
+	float    rate;       // music rate
+
+	// just for information, judging doesn't look at them.
+	float    visual_offset_ms;
+	float    speed;
+	uint32_t unused;
+};
+
+/* replay_event_t::type, the same numbers as input_event_t's for input.
+ * A gap isn't input: the recorder lost events from tick on, and ms says
+ * how many. A replay with one in it doesn't have the whole play. */
+enum {
+	REPLAY_PRESS = 0,
+	REPLAY_RELEASE,
+	REPLAY_GAP
+};
+
+struct replay_event_t {
+	uint32_t tick; // handed over just before this tick ran (ticks since start)
+	int32_t  ms;   // song time the judge got
+	uint8_t  lane;
+	uint8_t  type; // REPLAY_PRESS/RELEASE/GAP
+	uint16_t unused;
+};
+
+// Fill in the parts that come from this build and the chart.
+void init_header(replay_header_t &h, uint64_t chart, uint32_t tick_rate);
+
+/* Records as the song goes. Events go into a fixed buffer and get appended
+ * to the file a batch at a time, so record() never allocates or touches
+ * the disk, and a crash costs at most one batch. If the buffer fills up
+ * before anyone flushes, what doesn't fit is lost, and the file gets a
+ * REPLAY_GAP where it would have gone. */
+struct replay_writer_t {
+	enum {
+		capacity = 1024,
+		batch    = capacity / 2 // flush() writes once there's this much
+	};
+
+	replay_writer_t(): count(0), dropped(0), gap(0), gap_tick(0), active(false) {}
+
+	// Starts the file with the header. Under the write dir.
+	bool open(const std::string &filename, const replay_header_t &header);
+
+	void record(const replay_event_t &e);
+
+	// Write out what's buffered if there's a batch of it, or any at all if forced.
+	bool flush(bool force = false);
+
+	// Flush the rest. Fine to call when it isn't open.
+	void close();
+
+	bool is_open() const { return active; }
+
+	std::string    filename;
+	replay_event_t pending[capacity];
+	uint32_t       count;
+	uint32_t       dropped; // full buffer, nobody flushed
+	uint32_t       gap;     // dropped since the last flush, gap_tick on
+	uint32_t       gap_tick;
+	bool           active;
+};
+
+struct replay_t {
+	replay_header_t header;
+	std::vector<replay_event_t> events; // input only, gaps are taken out
+	uint32_t missing; // events the recorder lost; not the whole play if > 0
+
+	// From memory; a torn last event is dropped.
+	bool parse(const uint8_t *data, size_t size);
+
+	// Through the VFS.
+	bool load(const std::string &filename);
+};
+
+} // game
+} // vbeat
@@ -0,0 +1,144 @@
+#include <cmath>
+
+#include "vbeat.hpp"
+#include "game/session.hpp"
+
+namespace vbeat {
+namespace game {
+
+void session_t::reset(const chart::chart_t *_chart, uint32_t _tick_rate) {
+	this->chart        = _chart;
+	this->tick_rate    = _tick_rate;
+	this->tick_dt      = _tick_rate > 0 ? 1.0 / double(_tick_rate) : 0.0;
+	this->start_time   = -1.0;
+	this->time         = this->start_time;
+	this->ticks        = 0;
+	this->rate         = 1.0;
+	this->base_time    = this->start_time;
+	this->base_ticks   = 0;
+	this->playback      = nullptr;
+	this->playback_pos  = 0;
+	this->playback_tick = 0;
+	this->playback_ms   = INT32_MIN;
+	this->rejected      = 0;
+	this->judge.reset(_chart);
+	this->stats.reset();
+	this->recent.clear();
+}
+
+void session_t::play_back(const replay_t *replay) {
+	this->playback      = replay;
+	this->playback_pos  = 0;
+	this->playback_tick = 0;
+	this->playback_ms   = INT32_MIN;
+	this->rejected      = 0;
+}
+
+bool session_t::plausible(const replay_event_t &e) const {
+	if (e.tick < this->playback_tick || e.lane >= judge_t::max_lanes || e.type > REPLAY_RELEASE) {
+		return false;
+	}
+	uint32_t last = this->chart->rows.empty() ? 0 : this->chart->rows.back().ms;
+	if (this->time_at(double(e.tick)) * 1000.0 > double(last) + 2000.0) {
+		return false;
+	}
+	/* Live input is stamped before the tick it's handed over for ends, but
+	 * can be handed over any number of ticks late: stamped just after the
+	 * frame read its events, it waits for the next frame. Stamps come off
+	 * one queue in order though, so they never go back. */
+	double to = ceil(this->time_at(double(e.tick) + 1.0) * 1000.0);
+	return e.ms >= this->playback_ms && double(e.ms) <= to;
+}
+
+void session_t::apply(const replay_event_t &e) {
+	if (e.type != REPLAY_PRESS) {
+		return;
+	}
+	this->judge.press(e.lane, e.ms);
+	this->collect();
+}
+
+void session_t::tick() {
+	/* a replay's events go in where live input would have. Once the song's
+	 * over, whatever's left can't be real, so it all goes now rather than
+	 * ticking on to wherever it claims to be. */
+	if (this->playback) {
+		const std::vector<replay_event_t> &events = this->playback->events;
+		bool over = this->song_over();
+		while (this->playback_pos < events.size() && (over || events[this->playback_pos].tick <= this->ticks)) {
+			const replay_event_t &e = events[this->playback_pos++];
+			if (!this->plausible(e)) {
+				this->rejected += 1;
+				continue;
+			}
+			this->playback_tick = e.tick;
+			this->playback_ms   = e.ms;
+			this->apply(e);
+		}
+	}
+
+	// Derived from the tick count rather than summed, so it can't drift.
+	this->ticks += 1;
+	this->time = this->time_at(double(this->ticks));
+
+	this->judge.advance(int64_t(floor(this->time * 1000.0)));
+	this->collect();
+}
+
+double session_t::time_at(double tick) const {
+	return this->base_time + (tick - double(this->base_ticks)) * this->tick_dt * this->rate;
+}
+
+void session_t::set_rate(double _rate) {
+	this->base_time  = this->time;
+	this->base_ticks = this->ticks;
+	this->rate       = _rate;
+}
+
+void session_t::seek(double t) {
+	this->base_time  = t;
+	this->base_ticks = this->ticks;
+	this->time       = t;
+	this->judge.seek(int64_t(floor(t * 1000.0)));
+	this->recent.clear();
+}
+
+void session_t::save(snapshot_t &s) const {
+	s.time  = this->time;
+	s.judge = this->judge;
+	s.stats = this->stats;
+}
+
+void session_t::restore(const snapshot_t &s) {
+	this->base_time  = s.time;
+	this->base_ticks = this->ticks;
+	this->time       = s.time;
+	this->judge      = s.judge;
+	this->stats      = s.stats;
+	this->recent.clear();
+}
+
+bool session_t::song_over() const {
+	uint32_t last = this->chart->rows.empty() ? 0 : this->chart->rows.back().ms;
+	return this->time * 1000.0 > double(last) + 2000.0;
+}
+
+bool session_t::done() const {
+	return this->playback
+		&& this->playback_pos == this->playback->events.size()
+		&& this->song_over();
+}
+
+void session_t::collect() {
+	judgment_t j;
+	while (this->judge.next(j)) {
+		this->stats.add(j);
+		if (!this->recent.push(j)) {
+			this->recent.pop();
+			this->recent.push(j);
+		}
+	}
+}
+
+} // game
+} // vbeat
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+
+#include "chart/chart.hpp"
+#include "game/judge.hpp"
+#include "game/replay.hpp"
+#include "game/stats.hpp"
+#include "ring.hpp"
+
+namespace vbeat {
+namespace game {
+
+/* One play of a chart: the sim clock, the judge and what it decided.
+ * Nothing in here knows about windows, rendering or input devices, so the
+ * notefield drives it with live input and tools can drive it straight from
+ * a replay, and both get the same result. */
+struct session_t {
+	/* Everything a play has decided as of some song time, for practice to
+	 * jump back to. Plain data, so taking or restoring one is a copy. */
+	struct snapshot_t {
+		double  time;
+		judge_t judge;
+		stats_t stats;
+	};
+
+	session_t(): chart(nullptr), playback(nullptr) {}
+
+	// Back to the start of _chart.
+	void reset(const chart::chart_t *_chart, uint32_t _tick_rate);
+
+	/* Take input from a replay rather than apply() from here on, until
+	 * reset. Events that live input couldn't have made don't get played,
+	 * they're counted in rejected: out of order, after the song's over, or
+	 * stamped later than the tick they say they came before. */
+	void play_back(const replay_t *replay);
+
+	// Whether live input could have made e, given the events before it.
+	bool plausible(const replay_event_t &e) const;
+
+	// Hand the judge one input event, before the tick it belongs to.
+	void apply(const replay_event_t &e);
+
+	// Run one sim tick: replay input due by now, then the clock and misses.
+	void tick();
+
+	// Song time at a (fractional) tick count; input between ticks uses this.
+	double time_at(double tick) const;
+
+	// Song seconds per real second from here on. 1 for anything recorded.
+	void set_rate(double _rate);
+
+	/* Carry on from song time t. The judge starts over there, the stats are
+	 * left as they are. Ticks keep counting up either way. */
+	void seek(double t);
+
+	void save(snapshot_t &s) const;
+	void restore(const snapshot_t &s);
+
+	// Past the last note by long enough that everything's been judged.
+	bool song_over() const;
+
+	// Playing back and there's nothing left to play.
+	bool done() const;
+
+	const chart::chart_t *chart;
+
+	double   time;       // song time as of the last tick
+	double   start_time; // lead-in, song time at tick 0
+	double   tick_dt;
+	uint64_t ticks;      // since the song started
+	uint32_t tick_rate;
+	double   rate;
+
+	// time is base_time at tick base_ticks, and goes at rate from there.
+	double   base_time;
+	uint64_t base_ticks;
+
+	judge_t judge;
+	stats_t stats;
+
+	/* The latest judgments, for whoever wants to show them; take them off
+	 * the front. Once it's full the oldest go, nothing waits on it. */
+	ring_t<judgment_t, 256> recent;
+
+	const replay_t *playback;
+	size_t          playback_pos;
+	uint32_t        playback_tick; // latest event tick played so far
+	int32_t         playback_ms;   // and its stamp
+	uint32_t        rejected;
+
+private:
+	void collect();
+};
+
+} // game
+} // vbeat
@@ -0,0 +1,74 @@
+#include <cmath>
+#include <cstring>
+
+#include "vbeat.hpp"
+#include "game/stats.hpp"
+
+namespace vbeat {
+namespace game {
+
+const uint32_t stats_t::tier_points[tier::count] = {
+	3, // perfect
+	2, // great
+	1, // good
+	0  // miss
+};
+
+void stats_t::reset() {
+	memset(this, 0, sizeof(*this));
+}
+
+uint32_t stats_t::bin(int32_t offset) {
+	offset = offset < -hist_range ? -hist_range : offset;
+	offset = offset >  hist_range ?  hist_range : offset;
+	return uint32_t(offset + hist_range) / bin_ms;
+}
+
+void stats_t::add(const judgment_t &j) {
+	uint32_t t = j.tier < tier::count ? j.tier : uint32_t(tier::miss);
+	uint32_t l = j.lane < max_lanes ? j.lane : 0;
+	const uint32_t best = tier_points[tier::perfect];
+
+	this->tiers[t] += 1;
+	this->notes  += 1;
+	this->points += tier_points[t];
+	this->accuracy = float(double(this->points) / double(uint64_t(this->notes) * best));
+
+	lane_t &lane = this->lanes[l];
+	lane.tiers[t] += 1;
+	lane.notes    += 1;
+	this->lane_points[l] += tier_points[t];
+	lane.accuracy = float(double(this->lane_points[l]) / double(uint64_t(lane.notes) * best));
+
+	if (t == tier::miss) {
+		this->combo = 0;
+		return;
+	}
+	this->combo += 1;
+	this->max_combo = this->combo > this->max_combo ? this->combo : this->max_combo;
+
+	double x = double(j.offset);
+	this->hits += 1;
+	double delta = x - this->mean;
+	this->mean  += delta / double(this->hits);
+	this->m2    += delta * (x - this->mean);
+	this->stddev        = sqrt(this->m2 / double(this->hits));
+	this->unstable_rate = this->stddev * 10.0;
+	if (this->hits == 1 || j.offset > this->earliest) {
+		this->earliest = j.offset;
+	}
+	if (this->hits == 1 || j.offset < this->latest) {
+		this->latest = j.offset;
+	}
+
+	uint32_t &count = this->histogram[bin(j.offset)];
+	count += 1;
+	this->histogram_peak = count > this->histogram_peak ? count : this->histogram_peak;
+
+	uint32_t lane_hits = lane.notes - lane.tiers[tier::miss];
+	this->lane_sum[l] += x;
+	lane.mean = float(this->lane_sum[l] / double(lane_hits));
+}
+
+} // game
+} // vbeat
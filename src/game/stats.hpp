@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+
+#include "game/judge.hpp"
+
+namespace vbeat {
+namespace game {
+
+/* Running totals for a play, brought up to date one judgment at a time in
+ * constant time and fixed memory, however long the song. Everything a
+ * results screen or a meter wants is kept worked out, so reading it costs
+ * nothing. */
+struct stats_t {
+	enum {
+		max_lanes  = judge_t::max_lanes,
+		bin_ms     = 2,
+		hist_range = 256, // ms either side of 0; past the good window, for safety
+		hist_bins  = 2 * hist_range / bin_ms + 1
+	};
+
+	struct lane_t {
+		uint32_t notes;  // judged, misses included
+		uint32_t tiers[tier::count];
+		float    mean;   // hit error, ms
+		float    accuracy;
+	};
+
+	void reset();
+	void add(const judgment_t &j);
+
+	// Bin for an offset; the ends take everything past them.
+	static uint32_t bin(int32_t offset);
+
+	uint32_t tiers[tier::count];
+	uint32_t notes;      // judged, misses included
+	uint32_t combo;
+	uint32_t max_combo;
+	float    accuracy;   // 0-1, by tier_points
+
+	/* Hit error in ms over everything but misses, early positive. Welford's
+	 * running mean and variance, so no sum gets big enough to lose
+	 * precision. unstable_rate is the usual stddev * 10. */
+	uint32_t hits;
+	double   mean;
+	double   m2;
+	double   stddev;
+	double   unstable_rate;
+	int16_t  earliest, latest;
+
+	// hit error counts, bin_ms wide, centered on 0. peak is the biggest.
+	uint32_t histogram[hist_bins];
+	uint32_t histogram_peak;
+
+	lane_t lanes[max_lanes];
+
+	// points each tier is worth toward accuracy, out of tier_points[perfect].
+	static const uint32_t tier_points[tier::count];
+
+private:
+	uint64_t points;
+	uint64_t lane_points[max_lanes];
+	double   lane_sum[max_lanes]; // hit error; a lane is short enough to just sum
+};
+
+} // game
+} // vbeat
@@ -9,9 +9,11 @@
 #include <cassert>
 #include <bgfx/bgfx.h>
 
+#include "vbeat.hpp"
 #include "bitmap_font.hpp"
 #include "lodepng.h"
 #include "fs.hpp"
+#include "profiler.hpp"
 
 using namespace vbeat;
 
@@ -184,6 +186,8 @@ float bitmap_font_t::get_string_width(std::string string) {
 }
 
 bool bitmap_font_t::load(std::string fontfile) {
+	VBEAT_PROFILE_SCOPE("bitmap_font_t::load");
+	VBEAT_ALLOC_TAG(font);
 	if (!fs::is_file(fontfile)) {
 		printf("Couldn't find font: %s\n", fontfile.c_str());
 		return false;
@@ -209,6 +213,7 @@ bool bitmap_font_t::load(std::string fontfile) {
 }
 
 void bitmap_font_t::set_text(std::string text) {
+	VBEAT_ALLOC_TAG(font);
 	int Flen = text.length();
 	current_text = text;
 
@@ -226,8 +231,9 @@ void bitmap_font_t::set_text(std::string text) {
 	float y = float(LineHeight);
 	int line = -1;
 
-	std::vector<vertex_t> texlst(Flen*4);
-	std::vector<uint16_t> indices(Flen*6);
+	// scratch, bgfx::copy takes its own copy below.
+	frame_vector<vertex_t> texlst(Flen*4);
+	frame_vector<uint16_t> indices(Flen*6);
 
 	for (int i = 0; i < Flen; ++i) {
 		f=&Chars[text[i]];
@@ -4,6 +4,7 @@
 
 #include "vbeat.hpp"
 #include "fs.hpp"
+#include "profiler.hpp"
 
 #include "graphics/iqm.h"
 #include "graphics/mesh.hpp"
@@ -63,6 +64,8 @@ void read_anims(std::vector<uint8_t> &data, iqmheader *header) {
 }
 
 bool graphics::read_iqm(graphics::mesh &mesh, const std::string &filename, bool read_anims) {
+	VBEAT_PROFILE_SCOPE("graphics::read_iqm");
+	VBEAT_ALLOC_TAG(mesh);
 	std::vector<uint8_t> data;
 	fs::read_vector(data, filename);
 
@@ -102,7 +105,7 @@ bool graphics::read_iqm(graphics::mesh &mesh, const std::string &filename, bool
 	* attributes, because we can't really guarantee anything exists first. */
 	size_t stride = vertex_format.getStride();
 	size_t size = vertex_format.getSize(header->num_vertexes);
-	uint8_t *vertices = (uint8_t*)v_malloc(size);
+	uint8_t *vertices = (uint8_t*)v_malloc(size, alloc_tag::mesh);
 	for (auto &p : va_map) {
 		bgfx::Attrib::Enum attr = p.first;
 		iqmvertexarray va = p.second;
@@ -124,7 +127,7 @@ bool graphics::read_iqm(graphics::mesh &mesh, const std::string &filename, bool
 	* since it involves converting from uint to ushort). */
 	iqmtriangle *triangles = (iqmtriangle*)&data[header->ofs_triangles];
 	uint16_t indices_size = header->num_triangles * sizeof(uint16_t) * 3;
-	uint16_t *indices = (uint16_t*)v_malloc(indices_size);
+	uint16_t *indices = (uint16_t*)v_malloc(indices_size, alloc_tag::mesh);
 
 	for (unsigned int i = 0; i < header->num_triangles; i++) {
 		indices[i * 3 + 0] = triangles[i].vertex[0];
@@ -0,0 +1,114 @@
+#include "vbeat.hpp"
+#include "note_mesh.hpp"
+
+using namespace vbeat;
+using namespace graphics;
+
+namespace {
+	bgfx::VertexDecl note_decl() {
+		bgfx::VertexDecl decl;
+		decl
+			.begin()
+			.add(bgfx::Attrib::Position,  2, bgfx::AttribType::Float)
+			.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float)
+			.add(bgfx::Attrib::TexCoord1, 2, bgfx::AttribType::Float)
+			.end();
+		return decl;
+	}
+}
+
+note_mesh_t::note_mesh_t(texture_t *_texture):
+	texture(_texture)
+{
+	this->texture->refs++;
+	this->ibo = BGFX_INVALID_HANDLE;
+}
+
+note_mesh_t::~note_mesh_t() {
+	this->texture->refs--;
+	this->destroy();
+}
+
+void note_mesh_t::destroy() {
+	for (auto &s : this->sections) {
+		bgfx::destroyVertexBuffer(s.vbo);
+	}
+	this->sections.clear();
+	if (bgfx::isValid(this->ibo)) {
+		bgfx::destroyIndexBuffer(this->ibo);
+		this->ibo = BGFX_INVALID_HANDLE;
+	}
+	this->row_quads.clear();
+}
+
+void note_mesh_t::build(const note_vertex_t *vertices, size_t num_quads, const uint8_t *quads_per_row, size_t num_rows) {
+	VBEAT_ALLOC_TAG(mesh);
+	this->destroy();
+
+	this->row_quads.resize(num_rows + 1);
+	uint32_t total = 0;
+	for (size_t i = 0; i < num_rows; i++) {
+		this->row_quads[i] = total;
+		total += quads_per_row[i];
+	}
+	this->row_quads[num_rows] = total;
+
+	if (num_quads == 0) {
+		return;
+	}
+
+	bgfx::VertexDecl decl = note_decl();
+	for (size_t first = 0; first < num_quads; first += quads_per_section) {
+		size_t n = num_quads - first < size_t(quads_per_section) ? num_quads - first : size_t(quads_per_section);
+		section_t s;
+		s.first_quad = uint32_t(first);
+		s.num_quads  = uint32_t(n);
+		s.vbo = bgfx::createVertexBuffer(
+			bgfx::copy(vertices + first * 4, uint32_t(n * 4 * sizeof(note_vertex_t))),
+			decl
+		);
+		this->sections.push_back(s);
+	}
+
+	// only as big as the biggest section needs.
+	size_t max_quads = num_quads < size_t(quads_per_section) ? num_quads : size_t(quads_per_section);
+	const bgfx::Memory *mem = bgfx::alloc(uint32_t(max_quads * 6 * sizeof(uint16_t)));
+	uint16_t *indices = (uint16_t*)mem->data;
+	for (size_t q = 0; q < max_quads; q++) {
+		uint16_t base = uint16_t(q * 4);
+		indices[q*6 + 0] = base + 0;
+		indices[q*6 + 1] = base + 1;
+		indices[q*6 + 2] = base + 2;
+		indices[q*6 + 3] = base + 0;
+		indices[q*6 + 4] = base + 2;
+		indices[q*6 + 5] = base + 3;
+	}
+	this->ibo = bgfx::createIndexBuffer(mem);
+}
+
+void note_mesh_t::submit(uint8_t view, bgfx::ProgramHandle program, uint64_t state, size_t begin_row, size_t end_row) const {
+	if (begin_row >= end_row || this->sections.empty()) {
+		return;
+	}
+	uint32_t first = this->row_quads[begin_row];
+	uint32_t last  = this->row_quads[end_row];
+	if (first == last) {
+		return;
+	}
+
+	// Sections are in quad order, so find the ones this overlaps.
+	size_t lo_section = first / quads_per_section;
+	size_t hi_section = (last - 1) / quads_per_section;
+
+	for (size_t i = lo_section; i <= hi_section; i++) {
+		const section_t &s = this->sections[i];
+		uint32_t lo = first > s.first_quad ? first : s.first_quad;
+		uint32_t hi = last < s.first_quad + s.num_quads ? last : s.first_quad + s.num_quads;
+		bgfx::setVertexBuffer(s.vbo);
+		bgfx::setIndexBuffer(this->ibo, (lo - s.first_quad) * 6, (hi - lo) * 6);
+		bgfx::setState(state);
+		// Whatever the caller set (texture, transform, uniforms) has to
+		// last for every section, so hang on to it until the last one.
+		bgfx::submit(view, program, 0, i < hi_section);
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <bgfx/bgfx.h>
+#include <vector>
+#include "texture.hpp"
+
+namespace vbeat {
+namespace graphics {
+
+/* A note quad corner. x/y/u/v are the same as a sprite's, relative to the
+ * receptors; pos is where along the scroll the note sits. note.vs.sc moves
+ * it into place from u_scroll, so the geometry never changes mid-song. */
+struct note_vertex_t {
+	float x, y;
+	float u, v;
+	float pos;
+	float unused;
+};
+
+/* Every note in a chart, built once into static buffers. Quads go in row
+ * order, so the notes between two rows are one index range. Split into
+ * sections small enough for 16-bit indices, which all share one index
+ * buffer since quads are always 0 1 2, 0 2 3. */
+struct note_mesh_t {
+	enum {
+		quads_per_section = 16384
+	};
+
+	struct section_t {
+		bgfx::VertexBufferHandle vbo;
+		uint32_t first_quad;
+		uint32_t num_quads;
+	};
+
+	texture_t *texture;
+	std::vector<section_t> sections;
+	bgfx::IndexBufferHandle ibo;
+
+	// row i's quads are [row_quads[i], row_quads[i+1])
+	std::vector<uint32_t> row_quads;
+
+	note_mesh_t(texture_t *_texture);
+	virtual ~note_mesh_t();
+
+	/* 4 vertices per quad, and how many quads each row got (a row can have
+	 * none). Replaces whatever was there. */
+	void build(const note_vertex_t *vertices, size_t num_quads, const uint8_t *quads_per_row, size_t num_rows);
+
+	// Submit the notes for rows [begin_row, end_row).
+	void submit(uint8_t view, bgfx::ProgramHandle program, uint64_t state, size_t begin_row, size_t end_row) const;
+
+	void destroy();
+};
+
+} // graphics
+} // vbeat
@@ -0,0 +1,26 @@
+#include <cstdio>
+#include <vector>
+
+#include "vbeat.hpp"
+#include "shader.hpp"
+#include "fs.hpp"
+#include "hitch.hpp"
+#include "profiler.hpp"
+
+using namespace vbeat;
+
+bgfx::ShaderHandle graphics::load_shader(const std::string &filename) {
+	VBEAT_PROFILE_SCOPE("graphics::load_shader");
+	hitch::count(hitch::counter::shaders_created, filename.c_str());
+	// through a vector so fs doesn't need bgfx; shaders are small.
+	std::vector<uint8_t> data;
+	if (!fs::read_vector(data, filename)) {
+		printf("Shader: Couldn't read %s\n", filename.c_str());
+		return BGFX_INVALID_HANDLE;
+	}
+	return bgfx::createShader(bgfx::copy(data.data(), uint32_t(data.size())));
+}
+
+bgfx::ProgramHandle graphics::load_program(const std::string &vs, const std::string &fs) {
+	return bgfx::createProgram(load_shader(vs), load_shader(fs), true);
+}
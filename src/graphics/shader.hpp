@@ -0,0 +1,16 @@
+#pragma once
+
+#include <bgfx/bgfx.h>
+#include <string>
+
+namespace vbeat {
+namespace graphics {
+
+// Compiled shader from the VFS (shaders/*.bin).
+bgfx::ShaderHandle load_shader(const std::string &filename);
+
+// Both halves of a program; the program owns the shaders.
+bgfx::ProgramHandle load_program(const std::string &vs, const std::string &fs);
+
+} // graphics
+} // vbeat
@@ -5,7 +5,11 @@ using namespace graphics;
 
 sprite_batch_t::sprite_batch_t(texture_t *_texture):
 	dirty(true),
-	texture(_texture)
+	texture(_texture),
+	current(0),
+	stale(false),
+	num_indices(0),
+	index_quads(0)
 {
 	this->texture->refs++;
 	const int start_vertices = 16;
@@ -16,7 +20,7 @@ sprite_batch_t::sprite_batch_t(texture_t *_texture):
 		.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float)
 		.end();
 	this->vbo = bgfx::createDynamicVertexBuffer(start_vertices, decl, BGFX_BUFFER_ALLOW_RESIZE);
-	this->ibo = bgfx::createDynamicIndexBuffer(start_vertices*3, BGFX_BUFFER_ALLOW_RESIZE);
+	this->ibo = bgfx::createDynamicIndexBuffer(start_vertices/4*6, BGFX_BUFFER_ALLOW_RESIZE);
 }
 
 sprite_batch_t::~sprite_batch_t() {
@@ -25,21 +29,23 @@ sprite_batch_t::~sprite_batch_t() {
 	bgfx::destroyDynamicIndexBuffer(this->ibo);
 }
 
-void sprite_batch_t::add(const std::vector<vertex_t> &_vertices, const std::vector<uint16_t> &_indices) {
-	size_t base = this->vertices.size();
-	vertices.reserve(vertices.size() + _vertices.size());
-	indices.reserve(indices.size() + _indices.size());
-	// This, apparently, is the right way to append two vectors.
-	// You may note that it's much more verbose than a simple for...
-	this->vertices.insert(
-		std::end(this->vertices),
-		std::begin(_vertices),
-		std::end(_vertices)
-	);
-	for (auto &i : _indices) {
-		this->indices.push_back(base + i);
+vertex_t *sprite_batch_t::add(size_t n) {
+	std::vector<vertex_t> &vertices = this->vertices[this->current];
+
+	// Adding on to what we buffered last time, pick up where it left off.
+	if (this->stale) {
+		vertices = this->vertices[this->current ^ 1];
+		this->stale = false;
+	}
+
+	size_t base = vertices.size();
+	if (base / 4 + n > size_t(max_quads)) {
+		return nullptr;
 	}
+	// grows like push_back would, so a batch that's warmed up never allocates.
+	vertices.resize(base + n * 4);
 	this->dirty = true;
+	return vertices.data() + base;
 }
 
 void sprite_batch_t::buffer() {
@@ -47,26 +53,49 @@ void sprite_batch_t::buffer() {
 		return;
 	}
 
+	const std::vector<vertex_t> &vertices = this->vertices[this->current];
+	uint32_t quads = uint32_t(vertices.size() / 4);
+
 	bgfx::updateDynamicVertexBuffer(
 		this->vbo, 0,
 		bgfx::makeRef(
-			this->vertices.data(), this->vertices.size() * sizeof(vertex_t)
+			vertices.data(), vertices.size() * sizeof(vertex_t)
 		)
 	);
 
-	// FIXME: updating isn't throwing out the old data?
-	bgfx::updateDynamicIndexBuffer(
-		this->ibo, 0,
-		bgfx::makeRef(
-			this->indices.data(), this->indices.size() * sizeof(uint16_t)
-		)
-	);
+	// The indices never change, there just have to be enough of them.
+	if (quads > this->index_quads) {
+		uint32_t n = this->index_quads > 0 ? this->index_quads : 16;
+		while (n < quads) {
+			n *= 2;
+		}
+		n = n < uint32_t(max_quads) ? n : uint32_t(max_quads);
+
+		const bgfx::Memory *mem = bgfx::alloc(n * 6 * sizeof(uint16_t));
+		uint16_t *indices = (uint16_t*)mem->data;
+		for (uint32_t q = 0; q < n; q++) {
+			uint16_t base = uint16_t(q * 4);
+			indices[q*6 + 0] = base + 0;
+			indices[q*6 + 1] = base + 1;
+			indices[q*6 + 2] = base + 2;
+			indices[q*6 + 3] = base + 0;
+			indices[q*6 + 4] = base + 2;
+			indices[q*6 + 5] = base + 3;
+		}
+		bgfx::updateDynamicIndexBuffer(this->ibo, 0, mem);
+		this->index_quads = n;
+	}
+
+	this->num_indices = quads * 6;
 
+	// That set belongs to bgfx until the frame is rendered.
+	this->current ^= 1;
+	this->stale = true;
 	this->dirty = false;
 }
 
 void sprite_batch_t::clear() {
 	this->dirty = true;
-	vertices.clear();
-	indices.clear();
+	this->stale = false;
+	this->vertices[this->current].clear();
 }
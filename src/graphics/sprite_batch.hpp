@@ -11,12 +11,37 @@ struct vertex_t {
 	float u, v;
 };
 
+/* Quads, 4 vertices each, corners clockwise from the top left:
+ *
+ *  [0] -----> [1]
+ *   ^  -\   A  |
+ *   |    -\    |
+ *   | B    -\  v
+ *  [3]<-------[2]
+ *
+ * Every quad is indexed the same way, so there are no indices to add; the
+ * index buffer holds 0 1 2, 0 2 3 for as many quads as we've ever had and
+ * only gets touched when that goes up. */
 struct sprite_batch_t {
+	enum {
+		max_quads = 16384 // 16-bit indices
+	};
+
 	bool dirty;
 	texture_t *texture;
 
-	std::vector<vertex_t> vertices;
-	std::vector<uint16_t> indices;
+	/* Two sets of CPU-side vertices. bgfx keeps referencing whatever we
+	 * buffered until the render thread is done with that frame, so the next
+	 * frame gets built in the other set. */
+	std::vector<vertex_t> vertices[2];
+	int  current; // the set add() writes to
+	bool stale;   // flipped, but nobody cleared or refilled it yet
+
+	// how many indices the last buffer() uploaded.
+	uint32_t num_indices;
+
+	// quads the index buffer has room for.
+	uint32_t index_quads;
 
 	bgfx::DynamicVertexBufferHandle vbo;
 	bgfx::DynamicIndexBufferHandle  ibo;
@@ -24,7 +49,10 @@ struct sprite_batch_t {
 	sprite_batch_t(texture_t *_texture);
 	virtual ~sprite_batch_t();
 
-	void add(const std::vector<vertex_t> &_vertices, const std::vector<uint16_t> &_indices);
+	/* Room for n more quads, to be written in place: 4 * n vertices in the
+	 * order above. nullptr if that would go past max_quads. Good until the
+	 * next add(), buffer() or clear(). */
+	vertex_t *add(size_t n);
 
 	void buffer();
 	void clear();
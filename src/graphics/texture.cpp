@@ -3,6 +3,8 @@
 #include "lodepng.h"
 #include "texture.hpp"
 #include "fs.hpp"
+#include "profiler.hpp"
+#include "hitch.hpp"
 
 void* lodepng_malloc(size_t size) {
 	return vbeat::v_malloc(size);
@@ -23,12 +25,15 @@ namespace {
 }
 
 graphics::texture_t *graphics::get_texture(const std::string &filename) {
+	VBEAT_PROFILE_SCOPE("graphics::get_texture");
+	VBEAT_ALLOC_TAG(texture);
 	texture_t *tex = loaded_textures[filename];
 	if (tex == nullptr) {
 		unsigned w, h;
 		std::vector<unsigned char> pixels;
 		std::vector<unsigned char> file_data;
 		fs::read_vector(file_data, filename);
+		hitch::count(hitch::counter::textures_decoded, filename.c_str());
 		unsigned err = lodepng::decode(pixels, w, h, file_data);
 		if (err) {
 			puts("fuck");
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vbeat {
+namespace hash {
+	const uint64_t fnv_basis = 14695981039346656037ULL;
+	const uint64_t fnv_prime = 1099511628211ULL;
+
+	/* FNV-1a, 64 bit. Not for anything adversarial, just for telling files
+	 * apart. Pass the last result as h to keep going. */
+	inline uint64_t fnv1a(const void *data, size_t size, uint64_t h = fnv_basis) {
+		const uint8_t *p = (const uint8_t*)data;
+		for (size_t i = 0; i < size; i++) {
+			h ^= p[i];
+			h *= fnv_prime;
+		}
+		return h;
+	}
+} // hash
+} // vbeat
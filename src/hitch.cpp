@@ -0,0 +1,130 @@
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <SDL2/SDL_atomic.h>
+#include <bgfx/bgfx.h>
+
+#include "allocator.hpp"
+#include "clock.hpp"
+#include "hitch.hpp"
+
+namespace vbeat {
+namespace hitch {
+
+namespace {
+	std::atomic<uint32_t> counters[counter::count];
+
+	// a few names per frame, for the counters that have them.
+	enum {
+		max_names = 8,
+		name_size = 64
+	};
+
+	struct names_t {
+		char     names[max_names][name_size];
+		uint8_t  kind[max_names];
+		uint32_t num;
+	};
+
+	names_t       names;
+	SDL_SpinLock  names_lock = 0;
+
+	double   threshold_ms = 25.0;
+	uint64_t last_frame   = 0;
+	uint64_t frame_number = 0;
+	uint32_t num_hitches  = 0;
+
+	const char *counter_name(int c) {
+		static const char *list[counter::count] = {
+			"allocs",
+			"alloc bytes",
+			"files opened",
+			"textures decoded",
+			"shaders created"
+		};
+		return list[c];
+	}
+
+	double to_ms(int64_t ticks, int64_t freq) {
+		return freq > 0 ? double(ticks) * 1000.0 / double(freq) : 0.0;
+	}
+}
+
+void count(counter::Enum c, uint32_t n) {
+	counters[c].fetch_add(n, std::memory_order_relaxed);
+}
+
+void count(counter::Enum c, const char *what) {
+	count(c, 1);
+
+	SDL_AtomicLock(&names_lock);
+	if (names.num < max_names) {
+		strncpy(names.names[names.num], what, name_size - 1);
+		names.names[names.num][name_size - 1] = '\0';
+		names.kind[names.num] = uint8_t(c);
+		names.num += 1;
+	}
+	SDL_AtomicUnlock(&names_lock);
+}
+
+void set_threshold(double ms) {
+	threshold_ms = ms;
+}
+
+uint32_t total() {
+	return num_hitches;
+}
+
+void frame(uint32_t ticks, const bgfx::Stats *stats) {
+	uint64_t now = clock::now();
+
+	// the game thread's own allocations; the rest come in as they're published.
+	pool_allocator_t::publish_thread_counts();
+
+	uint32_t values[counter::count];
+	for (int i = 0; i < counter::count; i++) {
+		values[i] = counters[i].exchange(0, std::memory_order_relaxed);
+	}
+
+	names_t frame_names;
+	SDL_AtomicLock(&names_lock);
+	memcpy(&frame_names, &names, sizeof(names_t));
+	names.num = 0;
+	SDL_AtomicUnlock(&names_lock);
+
+	double ms = last_frame != 0 ? clock::to_seconds(now - last_frame) * 1000.0 : 0.0;
+	last_frame    = now;
+	frame_number += 1;
+
+	if (ms <= threshold_ms) {
+		return;
+	}
+	num_hitches += 1;
+
+	printf("Hitch: frame %u took %.2fms (limit %.2fms), %u ticks\n",
+		unsigned(frame_number), ms, threshold_ms, ticks
+	);
+	printf("Hitch:   %u allocs (%u KiB), %u files opened, %u textures decoded, %u shaders created\n",
+		values[counter::allocs], values[counter::alloc_bytes] >> 10,
+		values[counter::files_opened], values[counter::textures_decoded],
+		values[counter::shaders_created]
+	);
+	for (uint32_t i = 0; i < frame_names.num; i++) {
+		printf("Hitch:   %s: %s\n", counter_name(frame_names.kind[i]), frame_names.names[i]);
+	}
+
+	/* These are from the frame the render thread just finished, which is
+	 * the one before this, but a long render shows up as waitRender here. */
+	if (stats) {
+		printf("Hitch:   bgfx cpu %.2fms, gpu %.2fms, wait render %.2fms, wait submit %.2fms, %u draws\n",
+			to_ms(int64_t(stats->cpuTimeEnd - stats->cpuTimeBegin), int64_t(stats->cpuTimerFreq)),
+			to_ms(int64_t(stats->gpuTimeEnd - stats->gpuTimeBegin), int64_t(stats->gpuTimerFreq)),
+			to_ms(stats->waitRender, int64_t(stats->cpuTimerFreq)),
+			to_ms(stats->waitSubmit, int64_t(stats->cpuTimerFreq)),
+			stats->numDraw
+		);
+	}
+}
+
+} // hitch
+} // vbeat
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+namespace bgfx { struct Stats; }
+
+namespace vbeat {
+namespace hitch {
+	/* Things that tend to cause hitches, counted per frame. These are always
+	 * on (release too) and cost an atomic add each, so only count things
+	 * that are already expensive. Any thread. Allocations are the exception,
+	 * those get batched per thread by the allocator; other threads' land in
+	 * whichever frame they're published in. */
+	struct counter {
+		enum Enum {
+			allocs,
+			alloc_bytes,
+			files_opened,
+			textures_decoded,
+			shaders_created,
+			count
+		};
+	};
+
+	void count(counter::Enum c, uint32_t n = 1);
+
+	/* Same, with a name to show in the log (copied, only the first few per
+	 * frame are kept). */
+	void count(counter::Enum c, const char *what);
+
+	// Frames longer than this get logged.
+	void set_threshold(double ms);
+
+	/* Once per frame, game thread, right after bgfx::frame(). Times the
+	 * frame since the last call, logs it if it went long, and starts the
+	 * counters over. ticks is how many sim ticks the frame ran. */
+	void frame(uint32_t ticks, const bgfx::Stats *stats);
+
+	// How many frames have been logged so far.
+	uint32_t total();
+} // hitch
+} // vbeat
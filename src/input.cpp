@@ -0,0 +1,56 @@
+#include <cstdio>
+
+#include "vbeat.hpp"
+#include "clock.hpp"
+#include "input.hpp"
+#include "ring.hpp"
+
+using namespace vbeat;
+
+namespace {
+	spsc_ring_t<input::raw_event_t, 1024> events;
+	std::atomic<uint32_t> num_dropped(0);
+}
+
+void input::poll() {
+	SDL_Event e;
+	while (SDL_PollEvent(&e)) {
+		raw_event_t raw;
+		raw.time  = clock::now();
+		raw.event = e;
+
+		// Joysticks only send button events once they're opened.
+		if (e.type == SDL_JOYDEVICEADDED) {
+			SDL_JoystickOpen(e.jdevice.which);
+		}
+
+		if (!events.push(raw)) {
+			num_dropped += 1;
+		}
+	}
+}
+
+bool input::next(raw_event_t &e) {
+	return events.pop(e);
+}
+
+uint32_t input::dropped() {
+	return num_dropped;
+}
+
+// 6key layout; 4key charts only use the middle four.
+int input::key_lane(SDL_Keycode key) {
+	switch (key) {
+		case SDLK_s: return 0;
+		case SDLK_d: return 1;
+		case SDLK_f: return 2;
+		case SDLK_j: return 3;
+		case SDLK_k: return 4;
+		case SDLK_l: return 5;
+		default: return -1;
+	}
+}
+
+int input::button_lane(uint8_t button) {
+	return button < 6 ? int(button) : -1;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <cstdint>
+
+namespace vbeat {
+namespace input {
+	// An SDL event, stamped with clock::now() the moment we pulled it out.
+	struct raw_event_t {
+		SDL_Event event;
+		uint64_t  time;
+	};
+
+	/* Pump SDL and stamp everything that came in. SDL only wants events
+	 * pumped on the thread that made the window, so this is the main
+	 * thread's whole job: call it in a tight loop, and key presses get stamps
+	 * good to about a millisecond instead of a frame. */
+	void poll();
+
+	// Game thread: take the oldest stamped event, false if there's none.
+	bool next(raw_event_t &e);
+
+	// How many events were dropped because the game thread fell behind.
+	uint32_t dropped();
+
+	// Which lane a key or joystick button plays, or -1.
+	int key_lane(SDL_Keycode key);
+	int button_lane(uint8_t button);
+} // input
+} // vbeat
@@ -0,0 +1,291 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <SDL2/SDL_timer.h>
+#include <bgfx/bgfx.h>
+
+#include "clock.hpp"
+#include "pacing.hpp"
+
+namespace vbeat {
+namespace pacing {
+
+namespace {
+	// per-mode history, in counter ticks.
+	enum { history_size = 256 };
+
+	struct history_t {
+		uint64_t intervals[history_size];
+		uint32_t frames;
+		uint32_t late;
+	};
+
+	history_t  history[mode::count];
+	mode::Enum current = mode::vsync;
+
+	uint64_t refresh_period = 0;
+	uint64_t cap_period     = 0;
+	uint64_t margin         = 0;
+
+	// timestamps for the frame in flight
+	uint64_t frame_begin = 0;
+	uint64_t last_end    = 0;
+	uint64_t last_begin  = 0;
+
+	// how long update+draw took for the last few frames, for jit.
+	enum { work_history_size = 32 };
+	uint64_t work[work_history_size];
+	uint32_t work_index = 0;
+
+	/* Sample to present times. bgfx::frame() returns once the render thread
+	 * is done with (and has flipped) the frame before, so that's when the
+	 * previous frame's sample made it out. */
+	enum { latency_history_size = 16 };
+	uint64_t latency[latency_history_size];
+	uint32_t latency_count = 0;
+	uint64_t this_sample   = 0;
+	uint64_t prev_sample   = 0;
+
+	// Skip the first interval after a switch, it's measuring the switch.
+	bool skip_next = true;
+
+	// SDL_Delay can overshoot by about a ms (SDL asks Windows for 1ms timer
+	// resolution), so stop sleeping this far out and spin.
+	const double spin_ms = 2.0;
+
+	uint64_t from_ms(double ms) {
+		return uint64_t(ms * double(clock::frequency()) / 1000.0);
+	}
+
+	double to_ms(uint64_t counter) {
+		return clock::to_seconds(counter) * 1000.0;
+	}
+
+	uint64_t target_period(mode::Enum m) {
+		switch (m) {
+			case mode::vsync:
+			case mode::jit:
+				return refresh_period;
+			case mode::capped:
+				return cap_period;
+			default:
+				return 0;
+		}
+	}
+
+	// Worst of the recent frames; one slow frame in jit means a missed vblank.
+	uint64_t work_estimate() {
+		uint64_t worst = 0;
+		for (uint32_t i = 0; i < work_history_size; i++) {
+			worst = work[i] > worst ? work[i] : worst;
+		}
+		return worst;
+	}
+}
+
+const char *mode_name(mode::Enum m) {
+	static const char *names[mode::count] = {
+		"vsync",
+		"uncapped",
+		"capped",
+		"jit"
+	};
+	return m < mode::count ? names[m] : "?";
+}
+
+mode::Enum mode_from_name(const char *name, mode::Enum fallback) {
+	for (int i = 0; i < mode::count; i++) {
+		if (strcmp(name, mode_name(mode::Enum(i))) == 0) {
+			return mode::Enum(i);
+		}
+	}
+	return fallback;
+}
+
+void init(mode::Enum m, double refresh_hz, double cap_hz, double margin_ms) {
+	memset(history, 0, sizeof(history));
+	memset(work, 0, sizeof(work));
+	memset(latency, 0, sizeof(latency));
+
+	refresh_period = from_ms(1000.0 / (refresh_hz > 0.0 ? refresh_hz : 60.0));
+	cap_period     = from_ms(1000.0 / (cap_hz > 0.0 ? cap_hz : 240.0));
+	margin         = from_ms(margin_ms);
+
+	set_mode(m);
+}
+
+void set_mode(mode::Enum m) {
+	current   = m;
+	skip_next = true;
+	// the old mode's latencies don't say anything about this one.
+	latency_count = 0;
+	prev_sample   = 0;
+	printf("Pacing: %s\n", mode_name(m));
+}
+
+mode::Enum get_mode() {
+	return current;
+}
+
+uint32_t reset_flags() {
+	switch (current) {
+		case mode::vsync:
+			return BGFX_RESET_VSYNC | BGFX_RESET_FLIP_AFTER_RENDER | BGFX_RESET_FLUSH_AFTER_RENDER;
+		// Flush so the driver can't queue frames up behind our back, which
+		// would undo all the waiting.
+		case mode::jit:
+			return BGFX_RESET_VSYNC | BGFX_RESET_FLUSH_AFTER_RENDER;
+		case mode::capped:
+			return BGFX_RESET_FLUSH_AFTER_RENDER;
+		default:
+			return 0;
+	}
+}
+
+void sleep_until(uint64_t deadline) {
+	uint64_t spin = from_ms(spin_ms);
+	for (;;) {
+		uint64_t now = clock::now();
+		if (now >= deadline) {
+			return;
+		}
+		uint64_t left = deadline - now;
+		if (left <= spin) {
+			break;
+		}
+		SDL_Delay(uint32_t(to_ms(left - spin)));
+	}
+	while (clock::now() < deadline) {
+		// spin
+	}
+}
+
+void begin_frame() {
+	switch (current) {
+		case mode::capped: {
+			if (last_begin != 0) {
+				sleep_until(last_begin + cap_period);
+			}
+			break;
+		}
+		case mode::jit: {
+			/* bgfx::frame() returns once the render thread has taken the last
+			 * frame, and with vsync on that happens right after a flip. So the
+			 * next vblank is about a refresh after that; start early enough
+			 * to get this frame's work done before it. */
+			uint64_t lead = work_estimate() + margin;
+			if (last_end != 0 && refresh_period > lead) {
+				sleep_until(last_end + refresh_period - lead);
+			}
+			break;
+		}
+		default: break;
+	}
+
+	uint64_t now = clock::now();
+	if (last_begin != 0 && !skip_next) {
+		history_t &h = history[current];
+		uint64_t interval = now - last_begin;
+		h.intervals[h.frames % history_size] = interval;
+		h.frames += 1;
+
+		// more than half a slot over means it got shown a slot late.
+		uint64_t target = target_period(current);
+		if (target != 0 && interval > target + target / 2) {
+			h.late += 1;
+		}
+	}
+	skip_next  = false;
+	last_begin = now;
+	frame_begin = now;
+}
+
+void submit() {
+	work[work_index % work_history_size] = clock::now() - frame_begin;
+	work_index += 1;
+}
+
+void end_frame() {
+	last_end = clock::now();
+
+	if (prev_sample != 0 && last_end > prev_sample) {
+		latency[latency_count % latency_history_size] = last_end - prev_sample;
+		latency_count += 1;
+	}
+	prev_sample = this_sample;
+	this_sample = 0;
+}
+
+void sample(uint64_t sample) {
+	this_sample = sample;
+}
+
+uint64_t predict_present(uint64_t sample) {
+	uint32_t n = latency_count < uint32_t(latency_history_size) ? latency_count : uint32_t(latency_history_size);
+	// nothing to go on yet, guess a refresh.
+	if (n == 0) {
+		return sample + refresh_period;
+	}
+
+	// Average, but leave out the worst one so a single hitch doesn't
+	// shove the notes around for the next 16 frames.
+	uint64_t sum = 0, worst = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		sum  += latency[i];
+		worst = latency[i] > worst ? latency[i] : worst;
+	}
+	if (n > 2) {
+		return sample + (sum - worst) / (n - 1);
+	}
+	return sample + sum / n;
+}
+
+void get_stats(mode::Enum m, stats_t &stats) {
+	const history_t &h = history[m];
+	memset(&stats, 0, sizeof(stats));
+	stats.frames    = h.frames;
+	stats.late      = h.late;
+	stats.target_ms = to_ms(target_period(m));
+	if (m == current) {
+		stats.latency_ms = to_ms(predict_present(0));
+	}
+
+	uint32_t n = h.frames < uint32_t(history_size) ? h.frames : uint32_t(history_size);
+	if (n == 0) {
+		return;
+	}
+
+	double sum = 0.0;
+	stats.min_ms = 1e9;
+	for (uint32_t i = 0; i < n; i++) {
+		double ms = to_ms(h.intervals[i]);
+		sum += ms;
+		stats.min_ms = ms < stats.min_ms ? ms : stats.min_ms;
+		stats.max_ms = ms > stats.max_ms ? ms : stats.max_ms;
+	}
+	stats.mean_ms = sum / double(n);
+
+	double var = 0.0;
+	for (uint32_t i = 0; i < n; i++) {
+		double d = to_ms(h.intervals[i]) - stats.mean_ms;
+		var += d * d;
+	}
+	stats.jitter_ms = sqrt(var / double(n));
+}
+
+void report() {
+	for (int i = 0; i < mode::count; i++) {
+		stats_t s;
+		get_stats(mode::Enum(i), s);
+		if (s.frames == 0) {
+			continue;
+		}
+		printf("Pacing: %-8s %6u frames, %.2fms avg (%.2f-%.2f, sd %.2f), %u late\n",
+			mode_name(mode::Enum(i)), s.frames,
+			s.mean_ms, s.min_ms, s.max_ms, s.jitter_ms, s.late
+		);
+	}
+}
+
+} // pacing
+} // vbeat
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+namespace vbeat {
+namespace pacing {
+	/* How frames get to the screen.
+	 * vsync:    let the swap block. Never tears, most latency.
+	 * uncapped: go as fast as we can. Tears, least latency, cooks the GPU.
+	 * capped:   uncapped, but held to a set rate by a sleep+spin limiter.
+	 * jit:      vsync, but wait to start each frame until just before the
+	 *           next vblank, so the input it samples is as fresh as it gets. */
+	struct mode {
+		enum Enum {
+			vsync,
+			uncapped,
+			capped,
+			jit,
+			count
+		};
+	};
+
+	// Frame-to-frame intervals over the last few hundred frames in a mode.
+	struct stats_t {
+		uint32_t frames;    // total frames shown in this mode
+		uint32_t late;      // of those, how many missed their slot
+		double   target_ms; // 0 if there's no target (uncapped)
+		double   mean_ms;
+		double   min_ms;
+		double   max_ms;
+		double   jitter_ms; // standard deviation
+		double   latency_ms; // sample to present, see predict_present
+	};
+
+	/* refresh_hz: what the display runs at.
+	 * cap_hz:     rate for mode::capped.
+	 * margin_ms:  how early mode::jit starts a frame on top of the work time. */
+	void init(mode::Enum m, double refresh_hz, double cap_hz, double margin_ms);
+
+	void       set_mode(mode::Enum m);
+	mode::Enum get_mode();
+
+	const char *mode_name(mode::Enum m);
+	mode::Enum  mode_from_name(const char *name, mode::Enum fallback);
+
+	// bgfx::reset flags the current mode needs on top of everything else.
+	uint32_t reset_flags();
+
+	/* Call these around each frame on the game thread:
+	 * begin_frame() before input is read (this is where the limiter waits),
+	 * submit() right before bgfx::frame(), end_frame() right after. */
+	void begin_frame();
+	void submit();
+	void end_frame();
+
+	/* When a frame drawn from state at `sample` (a clock::now() value) is
+	 * likely to actually be on screen, going by how long the last few frames
+	 * took to get there. Call sample() with the time the frame was built for
+	 * so the guesses keep getting checked. */
+	void     sample(uint64_t sample);
+	uint64_t predict_present(uint64_t sample);
+
+	void get_stats(mode::Enum m, stats_t &stats);
+
+	// Log a line per mode that was used.
+	void report();
+
+	// Sleep most of the way to a clock::now() value, spin the rest.
+	void sleep_until(uint64_t deadline);
+} // pacing
+} // vbeat
@@ -0,0 +1,259 @@
+#include "profiler.hpp"
+
+#if VBEAT_PROFILE
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#include "vbeat.hpp"
+#include "clock.hpp"
+#include "fs.hpp"
+
+namespace vbeat {
+namespace profiler {
+
+namespace {
+	struct event_t {
+		const char *name;
+		uint64_t    begin;
+		uint64_t    end;
+	};
+
+	/* One per thread, written only by that thread. Readers copy out what
+	 * they want and then throw away anything the writer could have lapped
+	 * while they were at it, so nobody ever waits on anybody. */
+	enum {
+		max_threads = 8,
+		ring_size   = 1 << 14
+	};
+
+	struct thread_ring_t {
+		const char           *name;
+		std::atomic<uint32_t> head;
+		uint32_t              consumed; // by frame(), game thread only
+		event_t               events[ring_size];
+	};
+
+	// static, so setting up a thread never allocates.
+	thread_ring_t         rings[max_threads];
+	std::atomic<uint32_t> num_rings(0);
+
+	VBEAT_THREAD_LOCAL thread_ring_t *t_ring = nullptr;
+
+	// Per scope (and thread), how long it ran in each of the last frames.
+	enum {
+		max_entries   = 48,
+		history_size  = 64
+	};
+
+	struct entry_t {
+		const char *name;
+		uint32_t    thread;
+		uint64_t    frame_total;
+		uint32_t    frame_calls;
+		uint64_t    history[history_size];
+		uint32_t    calls[history_size];
+	};
+
+	entry_t  entries[max_entries];
+	uint32_t num_entries = 0;
+	uint32_t frame_index = 0;
+
+	entry_t *find_entry(const char *name, uint32_t thread) {
+		for (uint32_t i = 0; i < num_entries; i++) {
+			if (entries[i].name == name && entries[i].thread == thread) {
+				return &entries[i];
+			}
+		}
+		if (num_entries == max_entries) {
+			return nullptr;
+		}
+		entry_t *e = &entries[num_entries++];
+		memset(e, 0, sizeof(entry_t));
+		e->name   = name;
+		e->thread = thread;
+		return e;
+	}
+
+	double to_ms(uint64_t counter) {
+		return clock::to_seconds(counter) * 1000.0;
+	}
+
+	// Oldest index in [from, head) that's still safe to read.
+	uint32_t oldest(uint32_t from, uint32_t head) {
+		return head - from > uint32_t(ring_size) ? head - uint32_t(ring_size) : from;
+	}
+
+	// Anything at or before this may have been overwritten during a copy.
+	bool lapped(uint32_t index, uint32_t head_after) {
+		return head_after - index >= uint32_t(ring_size);
+	}
+
+	void append_escaped(std::string &out, const char *s) {
+		for (; *s; s++) {
+			if (*s == '"' || *s == '\\') {
+				out += '\\';
+			}
+			out += *s;
+		}
+	}
+}
+
+scope_t::scope_t(const char *_name):
+	name(_name),
+	begin(clock::now())
+{}
+
+scope_t::~scope_t() {
+	thread_ring_t *ring = t_ring;
+	if (!ring) {
+		return;
+	}
+	uint32_t h = ring->head.load(std::memory_order_relaxed);
+	event_t &e = ring->events[h & (ring_size - 1)];
+	e.name  = this->name;
+	e.begin = this->begin;
+	e.end   = clock::now();
+	ring->head.store(h + 1, std::memory_order_release);
+}
+
+void set_thread_name(const char *name) {
+	if (t_ring) {
+		t_ring->name = name;
+		return;
+	}
+	uint32_t i = num_rings.load();
+	do {
+		if (i == max_threads) {
+			printf("Profiler: Out of thread rings, not recording \"%s\".\n", name);
+			return;
+		}
+	} while (!num_rings.compare_exchange_weak(i, i + 1));
+
+	rings[i].name     = name;
+	rings[i].consumed = 0;
+	rings[i].head.store(0);
+	t_ring = &rings[i];
+}
+
+void frame() {
+	uint32_t n = num_rings.load(std::memory_order_acquire);
+	for (uint32_t t = 0; t < n; t++) {
+		thread_ring_t &ring = rings[t];
+		uint32_t head  = ring.head.load(std::memory_order_acquire);
+		uint32_t first = oldest(ring.consumed, head);
+		for (uint32_t i = first; i != head; i++) {
+			event_t e = ring.events[i & (ring_size - 1)];
+			if (lapped(i, ring.head.load(std::memory_order_acquire))) {
+				continue;
+			}
+			entry_t *entry = find_entry(e.name, t);
+			if (entry) {
+				entry->frame_total += e.end - e.begin;
+				entry->frame_calls += 1;
+			}
+		}
+		ring.consumed = head;
+	}
+
+	uint32_t slot = frame_index % history_size;
+	for (uint32_t i = 0; i < num_entries; i++) {
+		entry_t &e = entries[i];
+		e.history[slot] = e.frame_total;
+		e.calls[slot]   = e.frame_calls;
+		e.frame_total   = 0;
+		e.frame_calls   = 0;
+	}
+	frame_index += 1;
+}
+
+uint32_t get_budget(budget_t *budget, uint32_t max) {
+	uint32_t frames = frame_index < uint32_t(history_size) ? frame_index : uint32_t(history_size);
+	if (frames == 0) {
+		return 0;
+	}
+
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < num_entries; i++) {
+		const entry_t &e = entries[i];
+		uint64_t total = 0, worst = 0, calls = 0;
+		for (uint32_t f = 0; f < frames; f++) {
+			total += e.history[f];
+			calls += e.calls[f];
+			worst  = e.history[f] > worst ? e.history[f] : worst;
+		}
+
+		budget_t b;
+		b.name   = e.name;
+		b.thread = rings[e.thread].name;
+		b.avg_ms = to_ms(total) / double(frames);
+		b.max_ms = to_ms(worst);
+		b.calls  = double(calls) / double(frames);
+
+		// insertion sort, slowest first; there's only a handful.
+		uint32_t pos = count < max ? count : max;
+		while (pos > 0 && budget[pos - 1].avg_ms < b.avg_ms) {
+			if (pos < max) {
+				budget[pos] = budget[pos - 1];
+			}
+			pos--;
+		}
+		if (pos < max) {
+			budget[pos] = b;
+			count = count < max ? count + 1 : max;
+		}
+	}
+	return count;
+}
+
+bool export_trace(const std::string &filename) {
+	std::string out;
+	out.reserve(1 << 20);
+	out += "{\"traceEvents\":[\n";
+
+	bool first = true;
+	char buf[128];
+	uint32_t n = num_rings.load(std::memory_order_acquire);
+	for (uint32_t t = 0; t < n; t++) {
+		thread_ring_t &ring = rings[t];
+
+		snprintf(buf, sizeof(buf), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"",
+			first ? "" : ",\n", unsigned(t)
+		);
+		out += buf;
+		append_escaped(out, ring.name);
+		out += "\"}}";
+		first = false;
+
+		uint32_t head = ring.head.load(std::memory_order_acquire);
+		for (uint32_t i = oldest(0, head); i != head; i++) {
+			event_t e = ring.events[i & (ring_size - 1)];
+			if (lapped(i, ring.head.load(std::memory_order_acquire))) {
+				continue;
+			}
+			out += ",\n{\"name\":\"";
+			append_escaped(out, e.name);
+			// microseconds
+			snprintf(buf, sizeof(buf), "\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				unsigned(t),
+				clock::to_seconds(e.begin) * 1e6,
+				clock::to_seconds(e.end - e.begin) * 1e6
+			);
+			out += buf;
+		}
+	}
+	out += "\n]}\n";
+
+	if (!fs::write(filename, out)) {
+		printf("Profiler: Unable to write %s.\n", filename.c_str());
+		return false;
+	}
+	printf("Profiler: Wrote %s (%u KiB).\n", filename.c_str(), unsigned(out.size() >> 10));
+	return true;
+}
+
+} // profiler
+} // vbeat
+
+#endif
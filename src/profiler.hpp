@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Scoped CPU timers. Cheap, but not free, so debug only unless you ask.
+#if !defined(VBEAT_PROFILE)
+#	ifdef VBEAT_DEBUG
+#		define VBEAT_PROFILE 1
+#	else
+#		define VBEAT_PROFILE 0
+#	endif
+#endif
+
+#define VBEAT_PROFILE_CONCAT2(a, b) a##b
+#define VBEAT_PROFILE_CONCAT(a, b) VBEAT_PROFILE_CONCAT2(a, b)
+
+#if VBEAT_PROFILE
+/* Time everything from here to the end of the block. name has to outlive the
+ * program (i.e. a string literal), we only keep the pointer. */
+#	define VBEAT_PROFILE_SCOPE(name) vbeat::profiler::scope_t VBEAT_PROFILE_CONCAT(_profile_scope, __LINE__)(name)
+#	define VBEAT_PROFILE_THREAD(name) vbeat::profiler::set_thread_name(name)
+#	define VBEAT_PROFILE_FRAME() vbeat::profiler::frame()
+#else
+#	define VBEAT_PROFILE_SCOPE(name)
+#	define VBEAT_PROFILE_THREAD(name)
+#	define VBEAT_PROFILE_FRAME()
+#endif
+
+namespace vbeat {
+namespace profiler {
+#if VBEAT_PROFILE
+	struct scope_t {
+		scope_t(const char *name);
+		~scope_t();
+		const char *name;
+		uint64_t    begin;
+	};
+
+	/* Give this thread a ring to record into, and a name for the trace.
+	 * Call it first thing on every thread that gets profiled; threads that
+	 * don't are just not recorded. */
+	void set_thread_name(const char *name);
+
+	// Roll the budget table over. Once per frame, game thread.
+	void frame();
+
+	// One line of the budget table: time spent per frame in a scope,
+	// over the last 64 frames.
+	struct budget_t {
+		const char *name;
+		const char *thread;
+		double      avg_ms;
+		double      max_ms;
+		double      calls; // per frame
+	};
+
+	// Slowest scopes first. Returns how many got filled in.
+	uint32_t get_budget(budget_t *budget, uint32_t max);
+
+	/* Write whatever is still in the rings out as a Chrome trace
+	 * (chrome://tracing, or speedscope) into the save dir. */
+	bool export_trace(const std::string &filename);
+#endif
+} // profiler
+} // vbeat
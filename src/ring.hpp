@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace vbeat {
+
+/* Fixed-capacity lock-free queue for exactly one producer thread and one
+ * consumer thread. Never allocates. Capacity must be a power of two. */
+template <typename T, uint32_t N>
+struct spsc_ring_t {
+	static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+	spsc_ring_t(): head(0), tail(0) {}
+
+	// Producer side. Returns false if the consumer has fallen N behind.
+	bool push(const T &item) {
+		uint32_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == N) {
+			return false;
+		}
+		items[t & (N - 1)] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side. Look at the oldest item without taking it.
+	const T *peek() const {
+		uint32_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+		return &items[h & (N - 1)];
+	}
+
+	bool pop(T &item) {
+		const T *front = this->peek();
+		if (!front) {
+			return false;
+		}
+		item = *front;
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const {
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+private:
+	// kept apart so the two threads aren't fighting over one cache line.
+	std::atomic<uint32_t> head;
+	char pad0[64 - sizeof(std::atomic<uint32_t>)];
+	std::atomic<uint32_t> tail;
+	char pad1[64 - sizeof(std::atomic<uint32_t>)];
+	T items[N];
+};
+
+/* Same idea for when both ends are on one thread: fixed capacity, FIFO, no
+ * allocation, and queued items can be read in place. */
+template <typename T, uint32_t N>
+struct ring_t {
+	static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+	ring_t(): head(0), tail(0) {}
+
+	bool push(const T &item) {
+		if (this->size() == N) {
+			return false;
+		}
+		items[tail & (N - 1)] = item;
+		tail += 1;
+		return true;
+	}
+
+	uint32_t size() const {
+		return tail - head;
+	}
+
+	bool empty() const {
+		return head == tail;
+	}
+
+	// i'th oldest item.
+	const T &operator[](uint32_t i) const {
+		return items[(head + i) & (N - 1)];
+	}
+
+	T &operator[](uint32_t i) {
+		return items[(head + i) & (N - 1)];
+	}
+
+	/* Up to n items from the front that sit next to each other in memory.
+	 * If the run wraps around the end you get the first part; pop it and ask
+	 * again for the rest. */
+	const T *front_span(uint32_t n, uint32_t &count) const {
+		uint32_t start = head & (N - 1);
+		count = n < N - start ? n : N - start;
+		if (count > this->size()) {
+			count = this->size();
+		}
+		return &items[start];
+	}
+
+	void pop(uint32_t n = 1) {
+		head += n;
+	}
+
+	void clear() {
+		head = tail;
+	}
+
+private:
+	uint32_t head, tail;
+	T items[N];
+};
+
+} // vbeat
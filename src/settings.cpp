@@ -0,0 +1,98 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "vbeat.hpp"
+#include "fs.hpp"
+#include "settings.hpp"
+
+using namespace vbeat;
+
+namespace {
+	std::vector<std::pair<std::string, std::string>> values;
+
+	std::string trim(const std::string &s) {
+		size_t first = s.find_first_not_of(" \t\r\n");
+		if (first == std::string::npos) {
+			return std::string();
+		}
+		size_t last = s.find_last_not_of(" \t\r\n");
+		return s.substr(first, last - first + 1);
+	}
+
+	const std::string *find(const char *key) {
+		for (auto &kv : values) {
+			if (kv.first == key) {
+				return &kv.second;
+			}
+		}
+		return nullptr;
+	}
+}
+
+bool settings::load(const std::string &filename) {
+	std::string data;
+	if (!fs::is_file(filename) || !fs::read_string(data, filename)) {
+		printf("Settings: No %s, using defaults.\n", filename.c_str());
+		return false;
+	}
+
+	// read_string hands back the terminator too.
+	data.resize(strlen(data.c_str()));
+
+	size_t pos = 0;
+	while (pos < data.size()) {
+		size_t end = data.find('\n', pos);
+		if (end == std::string::npos) {
+			end = data.size();
+		}
+		std::string line = trim(data.substr(pos, end - pos));
+		pos = end + 1;
+
+		if (line.empty() || line[0] == '#' || line[0] == ';') {
+			continue;
+		}
+
+		size_t eq = line.find('=');
+		if (eq == std::string::npos) {
+			printf("Settings: Ignoring \"%s\".\n", line.c_str());
+			continue;
+		}
+
+		std::string key   = trim(line.substr(0, eq));
+		std::string value = trim(line.substr(eq + 1));
+
+		// last one wins
+		bool replaced = false;
+		for (auto &kv : values) {
+			if (kv.first == key) {
+				kv.second = value;
+				replaced  = true;
+			}
+		}
+		if (!replaced) {
+			values.push_back(std::make_pair(key, value));
+		}
+	}
+
+	printf("Settings: Loaded %u values from %s.\n", unsigned(values.size()), filename.c_str());
+
+	return true;
+}
+
+std::string settings::get_string(const char *key, const char *fallback) {
+	const std::string *v = find(key);
+	return v ? *v : std::string(fallback);
+}
+
+int settings::get_int(const char *key, int fallback) {
+	const std::string *v = find(key);
+	return v && !v->empty() ? atoi(v->c_str()) : fallback;
+}
+
+double settings::get_double(const char *key, double fallback) {
+	const std::string *v = find(key);
+	return v && !v->empty() ? atof(v->c_str()) : fallback;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+namespace vbeat {
+namespace settings {
+	/* Read key = value pairs out of a file in the VFS. Lines starting with
+	 * # or ; are comments. Load once at startup, before any other threads
+	 * exist; after that it's read only. */
+	bool load(const std::string &filename);
+
+	// Look something up, or get the fallback back.
+	std::string get_string(const char *key, const char *fallback = "");
+	int         get_int(const char *key, int fallback = 0);
+	double      get_double(const char *key, double fallback = 0.0);
+} // settings
+} // vbeat
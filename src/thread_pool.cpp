@@ -0,0 +1,108 @@
+#include <SDL2/SDL.h>
+
+#include "allocator.hpp"
+#include "thread_pool.hpp"
+
+namespace vbeat {
+
+thread_pool_t::thread_pool_t():
+	start(nullptr),
+	done(nullptr),
+	count(0),
+	fn(nullptr)
+{
+	SDL_AtomicSet(&next, 0);
+	SDL_AtomicSet(&quit, 0);
+}
+
+thread_pool_t::~thread_pool_t() {
+	this->shutdown();
+}
+
+void thread_pool_t::init(uint32_t workers) {
+	this->shutdown();
+	if (workers == 0) {
+		int cpus = SDL_GetCPUCount();
+		workers = cpus > 0 ? uint32_t(cpus) : 1;
+	}
+
+	this->start = SDL_CreateSemaphore(0);
+	this->done  = SDL_CreateSemaphore(0);
+	SDL_AtomicSet(&this->quit, 0);
+
+	// reserved up front, the threads hang on to pointers into it.
+	this->threads.resize(workers - 1);
+	for (uint32_t i = 0; i < workers - 1; i++) {
+		thread_t &t = this->threads[i];
+		t.pool   = this;
+		t.worker = i + 1;
+		t.thread = SDL_CreateThread(thread_main, "worker", &t);
+	}
+}
+
+void thread_pool_t::shutdown() {
+	if (!this->start) {
+		return;
+	}
+	SDL_AtomicSet(&this->quit, 1);
+	for (size_t i = 0; i < this->threads.size(); i++) {
+		SDL_SemPost(this->start);
+	}
+	for (auto &t : this->threads) {
+		SDL_WaitThread(t.thread, nullptr);
+	}
+	this->threads.clear();
+
+	SDL_DestroySemaphore(this->start);
+	SDL_DestroySemaphore(this->done);
+	this->start = nullptr;
+	this->done  = nullptr;
+}
+
+uint32_t thread_pool_t::size() const {
+	return uint32_t(this->threads.size()) + 1;
+}
+
+void thread_pool_t::run(uint32_t count, const std::function<void(uint32_t, uint32_t)> &fn) {
+	this->count = count;
+	this->fn    = &fn;
+	SDL_AtomicSet(&this->next, 0);
+
+	for (size_t i = 0; i < this->threads.size(); i++) {
+		SDL_SemPost(this->start);
+	}
+	this->work(0);
+	for (size_t i = 0; i < this->threads.size(); i++) {
+		SDL_SemWait(this->done);
+	}
+
+	this->fn = nullptr;
+}
+
+void thread_pool_t::work(uint32_t worker) {
+	for (;;) {
+		uint32_t job = uint32_t(SDL_AtomicAdd(&this->next, 1));
+		if (job >= this->count) {
+			break;
+		}
+		(*this->fn)(job, worker);
+	}
+}
+
+int thread_pool_t::thread_main(void *data) {
+	thread_t &t = *(thread_t*)data;
+	thread_pool_t &pool = *t.pool;
+	for (;;) {
+		SDL_SemWait(pool.start);
+		if (SDL_AtomicGet(&pool.quit)) {
+			break;
+		}
+		pool.work(t.worker);
+		SDL_SemPost(pool.done);
+	}
+
+	pool_allocator_t::flush_thread_cache();
+	return 0;
+}
+
+} // vbeat
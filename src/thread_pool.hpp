@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <SDL2/SDL_atomic.h>
+
+struct SDL_Thread;
+struct SDL_semaphore;
+
+namespace vbeat {
+
+/* A fixed set of worker threads for getting through lots of independent
+ * jobs. run() hands out job numbers one at a time off a shared counter, so
+ * uneven jobs still spread out evenly, and returns once they're all done.
+ * The calling thread pitches in as worker 0. */
+struct thread_pool_t {
+	thread_pool_t();
+	~thread_pool_t();
+
+	// Total workers, the caller included. 0 means one per core.
+	void init(uint32_t workers = 0);
+	void shutdown();
+
+	// Size per-worker scratch with this.
+	uint32_t size() const;
+
+	// fn(job, worker) for every job in [0, count), worker < size().
+	void run(uint32_t count, const std::function<void(uint32_t, uint32_t)> &fn);
+
+private:
+	struct thread_t {
+		thread_pool_t *pool;
+		uint32_t       worker;
+		SDL_Thread    *thread;
+	};
+
+	static int thread_main(void *data);
+	void work(uint32_t worker);
+
+	std::vector<thread_t> threads;
+	SDL_semaphore *start, *done;
+	SDL_atomic_t   next, quit;
+	uint32_t       count;
+	const std::function<void(uint32_t, uint32_t)> *fn;
+};
+
+} // vbeat
@@ -1,7 +1,6 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_syswm.h>
 #include <bx/bx.h>
-#include <bx/crtimpl.h>
 #include <bx/fpumath.h>
 #include <bgfx/bgfxplatform.h>
 
@@ -9,8 +8,17 @@
 #include <string>
 
 #include "vbeat.hpp"
+#include "allocator.hpp"
+#include "clock.hpp"
 #include "fs.hpp"
+#include "hitch.hpp"
+#include "input.hpp"
 #include "math.hpp"
+#include "pacing.hpp"
+#include "profiler.hpp"
+#include "ring.hpp"
+#include "settings.hpp"
+#include "chart/library.hpp"
 #include "graphics/bitmap_font.hpp"
 #include "graphics/texture.hpp"
 #include "graphics/sprite_batch.hpp"
@@ -29,43 +37,47 @@ extern "C" {
 }
 #endif // VBEAT_WINDOWS
 
-bx::AllocatorI* vbeat::get_allocator()
-{
-	static bx::CrtAllocator s_allocator;
-	return &s_allocator;
-}
-
-// c-style allocs... everything that allocates calls these.
-void *vbeat::v_malloc(size_t bytes) {
-	return bx::alloc(vbeat::get_allocator(), bytes);
-}
-
-void *vbeat::v_realloc(void *ptr, size_t new_size) {
-	return bx::realloc(vbeat::get_allocator(), ptr, new_size);
-}
-
-void vbeat::v_free(void *ptr) {
-	bx::free(vbeat::get_allocator(), ptr);
-}
+namespace video {
+	SDL_Window *wnd = nullptr;
+	int refresh_rate = 60;
+	SDL_Thread *render_thread = nullptr;
+	SDL_sem    *render_ready  = nullptr;
+	SDL_atomic_t render_quit;
+
+	/* bgfx's render thread. Calling renderFrame() before bgfx::init() is how
+	 * bgfx knows we're driving it ourselves; after that, each call renders
+	 * whatever the last bgfx::frame() on the game thread handed over, so a
+	 * slow present only holds this thread up. */
+	int render_main(void *) {
+		VBEAT_PROFILE_THREAD("render");
+		bgfx::renderFrame();
+		SDL_SemPost(render_ready);
+
+		while (!SDL_AtomicGet(&render_quit)) {
+			VBEAT_PROFILE_SCOPE("bgfx::renderFrame");
+			bgfx::RenderFrame::Enum result = bgfx::renderFrame();
+			if (result == bgfx::RenderFrame::Exiting) {
+				break;
+			}
+			// bgfx::init hasn't gotten far enough yet.
+			if (result == bgfx::RenderFrame::NoContext) {
+				SDL_Delay(1);
+			}
+		}
 
-// c++-style allocs. redirects to v_*
-void* operator new(size_t sz) {
-	void *ptr = vbeat::v_malloc(sz);
-	if (!ptr) {
-		throw std::bad_alloc();
+		pool_allocator_t::flush_thread_cache();
+		return 0;
 	}
-	return ptr;
-}
-
-void operator delete(void* ptr) VBEAT_NOEXCEPT
-{
-	vbeat::v_free(ptr);
-}
 
-using namespace vbeat;
+	void stop_render_thread() {
+		SDL_AtomicSet(&render_quit, 1);
+		SDL_WaitThread(render_thread, NULL);
+		SDL_DestroySemaphore(render_ready);
+		render_thread = nullptr;
+		render_ready  = nullptr;
+	}
 
-namespace video {
-	SDL_Window *wnd = nullptr;
+	// Main thread: window and render thread.
 	bool open(int w, int h, std::string title) {
 		printf("Video: Initializing...\n");
 
@@ -77,8 +89,30 @@ namespace video {
 			w, h,
 			SDL_WINDOW_OPENGL
 		);
+		if (!wnd) {
+			printf("Video: Unable to create window.\n");
+			return false;
+		}
 		bgfx::sdlSetWindow(wnd);
 
+		// 0 means the driver doesn't know, keep the guess.
+		SDL_DisplayMode mode;
+		if (SDL_GetWindowDisplayMode(wnd, &mode) == 0 && mode.refresh_rate > 0) {
+			refresh_rate = mode.refresh_rate;
+		}
+		printf("Video: Display refresh rate is %dHz.\n", refresh_rate);
+
+		SDL_AtomicSet(&render_quit, 0);
+		render_ready  = SDL_CreateSemaphore(0);
+		render_thread = SDL_CreateThread(render_main, "render", NULL);
+		SDL_SemWait(render_ready);
+
+		return true;
+	}
+
+	/* Game thread: whoever calls bgfx::init is the only thread allowed to
+	 * talk to bgfx from then on. */
+	bool start() {
 		if (!bgfx::init(
 			bgfx::RendererType::OpenGL,
 			BGFX_PCI_ID_NONE, 0, NULL,
@@ -93,8 +127,14 @@ namespace video {
 		return true;
 	}
 
-	void close() {
+	// Game thread. The render thread sees this and exits on its own.
+	void stop() {
 		bgfx::shutdown();
+	}
+
+	// Main thread, once the game thread is done with bgfx.
+	void close() {
+		stop_render_thread();
 		SDL_DestroyWindow(wnd);
 		SDL_QuitSubSystem(SDL_INIT_VIDEO);
 	}
@@ -107,19 +147,21 @@ struct screen_t : widget_t {
 
 	std::vector<widget_t*> widgets;
 
-	void input(const input_event_t &e) {
-		this->focused->input(e);
+	void input(const input_event_t *events, size_t count) {
+		this->focused->input(events, count);
 	}
 
 	void update(double delta) {
+		VBEAT_PROFILE_SCOPE("screen_t::update");
 		for (auto &w : this->widgets) {
 			w->update(delta);
 		}
 	}
 
-	void draw() {
+	void draw(double alpha) {
+		VBEAT_PROFILE_SCOPE("screen_t::draw");
 		for (auto &w : this->widgets) {
-			w->draw();
+			w->draw(alpha);
 		}
 	}
 };
@@ -128,22 +170,33 @@ struct game_state_t {
 	game_state_t():
 		queue_quit(false),
 		finished(false),
+		queue_trace(false),
+		queue_replay(false),
 		width(0),
 		height(0),
-		tick(0)
+		tick(0),
+		events_dropped(0)
 	{}
 	game_state_t(const game_state_t &other):
 		queue_quit(other.queue_quit),
 		finished(other.finished),
+		queue_trace(other.queue_trace),
+		queue_replay(other.queue_replay),
 		width(other.width),
 		height(other.height),
-		tick(other.tick)
+		tick(other.tick),
+		events_dropped(other.events_dropped)
 	{}
 	std::stack<screen_t*> screens;
-	std::stack<input_event_t> events;
+	chart::library_t library;
+	// waiting for the tick they happened in, oldest first.
+	ring_t<input_event_t, 512> events;
 	bool queue_quit, finished;
+	bool queue_trace;
+	bool queue_replay;
 	int width, height;
 	uint64_t tick;
+	uint32_t events_dropped;
 };
 
 uint32_t debug_flags = 0
@@ -151,28 +204,46 @@ uint32_t debug_flags = 0
 	| BGFX_DEBUG_TEXT
 #endif
 	;
+// vsync and friends come from pacing::reset_flags.
 uint32_t reset_flags = 0
-	| BGFX_RESET_VSYNC
 	| BGFX_RESET_DEPTH_CLAMP
 	| BGFX_RESET_SRGB_BACKBUFFER
-	| BGFX_RESET_FLIP_AFTER_RENDER
-	| BGFX_RESET_FLUSH_AFTER_RENDER
 	;
 
+const auto queue_event = [](game_state_t &gs, const input_event_t &e) {
+	if (!gs.events.push(e)) {
+		gs.events_dropped += 1;
+	}
+};
+
 const auto handle_events = [](game_state_t &gs) {
-	SDL_Event e;
-	while (SDL_PollEvent(&e)) {
+	VBEAT_PROFILE_SCOPE("handle_events");
+	VBEAT_NO_ALLOC_SCOPE("handle_events");
+	input::raw_event_t raw;
+	while (input::next(raw)) {
+		const SDL_Event &e = raw.event;
 		switch (e.type) {
 			case SDL_QUIT: {
 				gs.queue_quit = true;
 				break;
 			}
-			case SDL_KEYDOWN: {
-				input_event_t ie;
-				ie.key = e.key.keysym.sym;
-				gs.events.push(ie);
-			}
+			case SDL_KEYDOWN:
 			case SDL_KEYUP: {
+				if (e.key.repeat) {
+					break;
+				}
+				input_event_t ie;
+				ie.type   = e.type == SDL_KEYDOWN ? input_event_t::press : input_event_t::release;
+				ie.device = input_event_t::keyboard;
+				ie.lane   = int8_t(input::key_lane(e.key.keysym.sym));
+				ie.button = 0;
+				ie.key    = e.key.keysym.sym;
+				ie.time   = raw.time;
+				queue_event(gs, ie);
+
+				if (e.type != SDL_KEYDOWN) {
+					break;
+				}
 				if (e.key.keysym.sym == SDLK_ESCAPE) {
 					gs.queue_quit = true;
 				}
@@ -184,6 +255,37 @@ const auto handle_events = [](game_state_t &gs) {
 					debug_flags ^= BGFX_DEBUG_WIREFRAME;
 					bgfx::setDebug(debug_flags);
 				}
+#if VBEAT_ALLOC_GUARD
+				if (e.key.keysym.sym == SDLK_3) {
+					v_set_alloc_guard(!v_alloc_guard_armed());
+				}
+#endif
+				if (e.key.keysym.sym == SDLK_4) {
+					int next = (pacing::get_mode() + 1) % pacing::mode::count;
+					pacing::set_mode(pacing::mode::Enum(next));
+					bgfx::reset(gs.width, gs.height, reset_flags | pacing::reset_flags());
+				}
+				if (e.key.keysym.sym == SDLK_6) {
+					gs.queue_replay = true;
+				}
+#if VBEAT_PROFILE
+				// written out after the frame, it allocates.
+				if (e.key.keysym.sym == SDLK_5) {
+					gs.queue_trace = true;
+				}
+#endif
+				break;
+			}
+			case SDL_JOYBUTTONDOWN:
+			case SDL_JOYBUTTONUP: {
+				input_event_t ie;
+				ie.type   = e.type == SDL_JOYBUTTONDOWN ? input_event_t::press : input_event_t::release;
+				ie.device = uint8_t(1 + e.jbutton.which);
+				ie.lane   = int8_t(input::button_lane(e.jbutton.button));
+				ie.button = e.jbutton.button;
+				ie.key    = SDLK_UNKNOWN;
+				ie.time   = raw.time;
+				queue_event(gs, ie);
 				break;
 			}
 			case SDL_JOYDEVICEADDED: {
@@ -201,58 +303,146 @@ const auto handle_events = [](game_state_t &gs) {
 			}
 		}
 	}
+};
 
-	while (!gs.events.empty()) {
-		gs.screens.top()->input(gs.events.top());
-		gs.events.pop();
+/* Hand the screen everything that happened before `until` (a clock::now()
+ * value), in order. Contiguous runs go over in one call. */
+const auto deliver_events = [](game_state_t &gs, uint64_t until) {
+	screen_t *s = gs.screens.top();
+	while (!gs.events.empty() && gs.events[0].time < until) {
+		uint32_t n = 1;
+		while (n < gs.events.size() && gs.events[n].time < until) {
+			n++;
+		}
+		uint32_t count;
+		const input_event_t *batch = gs.events.front_span(n, count);
+		s->input(batch, count);
+		gs.events.pop(count);
 	}
 };
 
 #include "widgets/font_test.hpp"
 #include "widgets/notefield.hpp"
 
-double get_time() {
-	return double(SDL_GetPerformanceCounter()) / SDL_GetPerformanceFrequency();
-}
+// The simulation ticks at a fixed rate, independent of the display.
+const uint64_t tick_rate = 1000;
 
-int main(int, char **argv) {
-	fs::state vfs(argv[0]);
+// After a long stall, catch up over a few frames instead of all at once.
+const uint64_t max_ticks_per_frame = 250;
 
+void draw_debug_overlay(const game_state_t &gs, const notefield_t *field) {
 #ifdef VBEAT_DEBUG
-	setvbuf(stdout, NULL, _IONBF, 0);
+	// all kept up to date by the session, nothing to add up here.
+	if (field) {
+		const game::stats_t &s = field->session.stats;
+		bgfx::dbgTextPrintf(0, 0, 0x0f, "Score: %.2f%%, combo %u (max %u), mean %+.1fms, UR %.1f",
+			s.accuracy * 100.0, s.combo, s.max_combo, s.mean, s.unstable_rate
+		);
+	}
+	frame_stats_t fstats = v_frame_stats();
+	bgfx::dbgTextPrintf(0, 1, 0x0f, "Frame arena: %uK/%uK (peak %uK, %u bytes spilled)",
+		unsigned(fstats.used >> 10), unsigned(fstats.capacity >> 10),
+		unsigned(fstats.high_water >> 10), unsigned(fstats.overflow)
+	);
+#	if VBEAT_ALLOC_GUARD
+	if (v_alloc_guard_armed()) {
+		bgfx::dbgTextPrintf(60, 1, 0x0c, "No-alloc scopes armed");
+	}
+#	endif
+	pacing::stats_t pstats;
+	pacing::get_stats(pacing::get_mode(), pstats);
+	bgfx::dbgTextPrintf(0, 2, 0x0f, "Present: %-8s %.2fms (%.2f-%.2f, sd %.2f) %u late, +%.1fms",
+		pacing::mode_name(pacing::get_mode()),
+		pstats.mean_ms, pstats.min_ms, pstats.max_ms, pstats.jitter_ms, pstats.late,
+		pstats.latency_ms
+	);
+	if (uint32_t dropped = input::dropped() + gs.events_dropped) {
+		bgfx::dbgTextPrintf(60, 2, 0x0c, "%u input events dropped", dropped);
+	}
+#	if VBEAT_HEAP_TRACKING
+	heap_tag_stats_t hstats[alloc_tag::count];
+	v_heap_stats(hstats);
+	bgfx::dbgTextPrintf(0, 3, 0x0f, "Heap      live KiB   blocks  allocs/frame  peak KiB");
+	for (int i = 0; i < alloc_tag::count; i++) {
+		const heap_tag_stats_t &t = hstats[i];
+		bgfx::dbgTextPrintf(0, uint16_t(4 + i), t.frame_allocs > 0 ? 0x0e : 0x0f,
+			"%-8s %9u %8u %13u %9u",
+			v_alloc_tag_name(alloc_tag::Enum(i)),
+			unsigned(t.live_bytes >> 10), unsigned(t.live_count),
+			unsigned(t.frame_allocs), unsigned(t.high_water >> 10)
+		);
+	}
+#	endif
+#	if VBEAT_PROFILE
+	// against the time we have per frame in this mode
+	double frame_ms = pstats.target_ms > 0.0 ? pstats.target_ms : 1000.0 / double(video::refresh_rate);
+	profiler::budget_t budget[10];
+	uint32_t num_budget = profiler::get_budget(budget, 10);
+	uint16_t row = uint16_t(5 + alloc_tag::count);
+	bgfx::dbgTextPrintf(0, row++, 0x0f, "Scope                  thread    avg ms   max ms  calls  budget");
+	for (uint32_t i = 0; i < num_budget; i++) {
+		const profiler::budget_t &b = budget[i];
+		double pct = b.avg_ms / frame_ms * 100.0;
+		bgfx::dbgTextPrintf(0, row++, pct > 25.0 ? 0x0e : 0x0f,
+			"%-22.22s %-8.8s %7.3f %8.3f %6.1f %6.1f%%",
+			b.name, b.thread, b.avg_ms, b.max_ms, b.calls, pct
+		);
+	}
+#	endif
 #endif
+}
 
-	SDL_InitSubSystem(SDL_INIT_EVENTS);
-	SDL_InitSubSystem(SDL_INIT_TIMER);
-
-	game_state_t gs;
-
-	std::string title = "Varibeat";
+// Set by the game thread on its way out, so the main thread stops polling.
+SDL_atomic_t game_done;
 
-	gs.width  = 1280;
-	gs.height = 720;
+/* Everything but input capture lives on this thread: it owns bgfx, runs the
+ * fixed-rate simulation and produces frames for the render thread. */
+int game_main(void *data) {
+	game_state_t &gs = *(game_state_t*)data;
+	VBEAT_PROFILE_THREAD("game");
 
-	if (!video::open(gs.width, gs.height, title)) {
+	if (!video::start()) {
+		SDL_AtomicSet(&game_done, 1);
 		return EXIT_FAILURE;
 	}
 
-	bgfx::reset(gs.width, gs.height, reset_flags);
-	bgfx::setDebug(debug_flags);
+	pacing::init(
+		pacing::mode_from_name(settings::get_string("present_mode", "vsync").c_str(), pacing::mode::vsync),
+		double(video::refresh_rate),
+		settings::get_double("frame_cap", 240.0),
+		settings::get_double("jit_margin_ms", 1.0)
+	);
 
-	screen_t *_s = new screen_t();
-	// XXX: why isn't the widget_t constructor working?
-	notefield_t *w = new notefield_t();
-	w->parent = _s;
-	w->init();
-	_s->widgets.push_back(w);
-	_s->focused = w;
+	// a frame and a half: in vsync, one missed vblank.
+	hitch::set_threshold(settings::get_double("hitch_ms", 1500.0 / double(video::refresh_rate)));
 
-	font_test_t *f = new font_test_t();
-	f->parent = _s;
-	f->init();
-	_s->widgets.push_back(f);
+	// whatever was there last time now, the disk gets checked in the background.
+	chart::library::open(gs.library, "songs", "library.idx");
+
+	bgfx::reset(gs.width, gs.height, reset_flags | pacing::reset_flags());
+	bgfx::setDebug(debug_flags);
 
-	gs.screens.push(_s);
+	notefield_t *field = nullptr;
+	{
+		VBEAT_ALLOC_TAG(ui);
+		screen_t *_s = new screen_t();
+		// XXX: why isn't the widget_t constructor working?
+		notefield_t *w = new notefield_t();
+		w->parent      = _s;
+		w->tick_rate   = uint32_t(tick_rate);
+		w->view_height = float(gs.height);
+		w->init();
+		field = w;
+		_s->widgets.push_back(w);
+		_s->focused = w;
+
+		font_test_t *f = new font_test_t();
+		f->parent = _s;
+		f->init();
+		_s->widgets.push_back(f);
+
+		gs.screens.push(_s);
+	}
 
 	float view[16], proj[16];
 	bx::mtxIdentity(view);
@@ -261,17 +451,30 @@ int main(int, char **argv) {
 	bgfx::setViewRect(0, 0, 0, gs.width, gs.height);
 	bgfx::setViewScissor(0, 0, 0, gs.width, gs.height);
 
-	double last = get_time();
+	const double tick_dt = 1.0 / double(tick_rate);
+
+	// Positive shows notes later, for displays with lag we can't see.
+	const int64_t visual_offset = int64_t(
+		settings::get_double("visual_offset_ms", 0.0) * double(clock::frequency()) / 1000.0
+	);
 	while (!gs.finished) {
+		// the limiter waits here, so input is read as late as possible.
+		pacing::begin_frame();
+
 		handle_events(gs);
+		chart::library::poll(gs.library);
 
 		if (gs.queue_quit) {
 			gs.finished = true;
 		}
 
-		double now = get_time();
-		double delta = now - last;
-		last = now;
+		// the last play again, through the judge, in place of live input.
+		if (gs.queue_replay) {
+			gs.queue_replay = false;
+			if (!field->last_replay.empty()) {
+				field->play_back(field->last_replay);
+			}
+		}
 
 		bgfx::touch(0);
 		bgfx::setViewClear(0,
@@ -280,14 +483,65 @@ int main(int, char **argv) {
 			1.0f
 		);
 
+		// Tick count comes straight from the counter, so the sim can't drift
+		// away from wall time no matter how uneven the frames are.
+		uint64_t now = clock::now();
+		uint64_t target = clock::to_ticks(now, tick_rate);
+		uint64_t steps = 0;
+
 		auto &s = gs.screens.top();
-		s->update(delta);
-		s->draw();
+		while (gs.tick < target && steps < max_ticks_per_frame) {
+			// input lands in the tick it happened in, before that tick runs.
+			deliver_events(gs, clock::from_ticks(gs.tick + 1, tick_rate));
+			s->update(tick_dt);
+			gs.tick += 1;
+			steps += 1;
+		}
+
+		/* Draw for when this frame will be on screen rather than now; that's
+		 * a frame or two out, and without this the notes lag by as much.
+		 * If we're still behind, just draw the latest tick as-is. */
+		double alpha = 0.0;
+		if (gs.tick == target) {
+			pacing::sample(now);
+			int64_t present = int64_t(pacing::predict_present(now)) - visual_offset;
+			int64_t ahead   = present - int64_t(clock::from_ticks(gs.tick, tick_rate));
+			alpha = double(ahead) * double(tick_rate) / double(clock::frequency());
+		}
+		s->draw(alpha);
+
+		draw_debug_overlay(gs, field);
 
-		bgfx::frame();
+		pacing::submit();
+		{
+			VBEAT_PROFILE_SCOPE("bgfx::frame");
+			bgfx::frame();
+		}
+		pacing::end_frame();
+		hitch::frame(uint32_t(steps), bgfx::getStats());
 		bgfx::dbgTextClear();
+
+		// recycles the arena from the frame before this one.
+		v_frame_reset();
+#if VBEAT_HEAP_TRACKING
+		v_heap_frame();
+#endif
+		VBEAT_PROFILE_FRAME();
+#if VBEAT_PROFILE
+		if (gs.queue_trace) {
+			profiler::export_trace("trace.json");
+			gs.queue_trace = false;
+		}
+#endif
 	}
 
+	pacing::report();
+
+	frame_stats_t fstats = v_frame_stats();
+	printf("Frame arena: high-water mark %u of %u bytes.\n",
+		unsigned(fstats.high_water), unsigned(fstats.capacity)
+	);
+
 	while (!gs.screens.empty()) {
 		screen_t *top = gs.screens.top();
 		for (auto &w : top->widgets) {
@@ -298,10 +552,64 @@ int main(int, char **argv) {
 	}
 
 	graphics::unload_textures();
+	chart::library::close();
+
+	video::stop();
+
+	pool_allocator_t::flush_thread_cache();
+	SDL_AtomicSet(&game_done, 1);
+
+	return EXIT_SUCCESS;
+}
+
+int main(int, char **argv) {
+	// first, so everything (the profiler included) has a clock to go by.
+	clock::init();
+	VBEAT_PROFILE_THREAD("main");
+
+	fs::state vfs(argv[0]);
+	settings::load("settings.ini");
+
+#ifdef VBEAT_DEBUG
+	setvbuf(stdout, NULL, _IONBF, 0);
+#endif
+
+	SDL_InitSubSystem(SDL_INIT_EVENTS);
+	SDL_InitSubSystem(SDL_INIT_TIMER);
+	SDL_InitSubSystem(SDL_INIT_JOYSTICK);
+
+	game_state_t gs;
+
+	std::string title = "Varibeat";
+
+	gs.width  = 1280;
+	gs.height = 720;
+
+	if (!video::open(gs.width, gs.height, title)) {
+		return EXIT_FAILURE;
+	}
+
+#if VBEAT_ALLOC_GUARD
+	if (SDL_getenv("VBEAT_ALLOC_GUARD")) {
+		v_set_alloc_guard(true);
+	}
+#endif
+
+	SDL_AtomicSet(&game_done, 0);
+	SDL_Thread *game_thread = SDL_CreateThread(game_main, "game", &gs);
+
+	// From here on this thread only collects input, see input::poll.
+	while (!SDL_AtomicGet(&game_done)) {
+		input::poll();
+		SDL_Delay(1);
+	}
+
+	int status = EXIT_SUCCESS;
+	SDL_WaitThread(game_thread, &status);
 
 	video::close();
 
 	SDL_Quit();
 
-	return EXIT_SUCCESS;
+	return status;
 }
@@ -33,8 +33,25 @@
 #	endif
 #endif
 
+// __declspec(thread) and __thread only take POD with constant initializers,
+// but unlike thread_local they work on VS2013.
+#if !defined(VBEAT_THREAD_LOCAL)
+#	if defined(_MSC_VER)
+#		define VBEAT_THREAD_LOCAL __declspec(thread)
+#	else
+#		define VBEAT_THREAD_LOCAL __thread
+#	endif
+#endif
+
+// Every allocation and free written to alloc.trace, for tools/allocbench.
+// Costs a lock per allocation, so only when asked for (genie --alloc-trace).
+#if !defined(VBEAT_ALLOC_TRACE)
+#	define VBEAT_ALLOC_TRACE 0
+#endif
+
 #include <cstddef> // size_t, ...
 #include <memory>  // shared_ptr, ...
+#include <vector>
 
 void* operator new(size_t sz);
 void operator delete(void* ptr) VBEAT_NOEXCEPT;
@@ -43,12 +60,116 @@ namespace bx {
 	struct AllocatorI;
 }
 
+// Per-tag heap accounting. Costs a lock per allocation, so debug only unless
+// you ask for it.
+#if !defined(VBEAT_HEAP_TRACKING)
+#	ifdef VBEAT_DEBUG
+#		define VBEAT_HEAP_TRACKING 1
+#	else
+#		define VBEAT_HEAP_TRACKING 0
+#	endif
+#endif
+
+// Allocation-forbidden scopes for hot paths. Also debug only.
+#if !defined(VBEAT_ALLOC_GUARD)
+#	ifdef VBEAT_DEBUG
+#		define VBEAT_ALLOC_GUARD 1
+#	else
+#		define VBEAT_ALLOC_GUARD 0
+#	endif
+#endif
+
 namespace vbeat {
+	struct alloc_tag {
+		enum Enum {
+			general,
+			texture,
+			font,
+			mesh,
+			chart,
+			ui,
+			fs,
+			count
+		};
+	};
+
 	bx::AllocatorI *get_allocator();
 	void *v_malloc(size_t bytes);
+	void *v_malloc(size_t bytes, alloc_tag::Enum tag);
 	void *v_realloc(void *ptr, size_t new_size);
 	void  v_free(void *ptr);
 
+	/* Tag used for anything this thread allocates without naming one (i.e.
+	 * new/delete, lodepng, STL containers). Returns the previous tag. Use
+	 * VBEAT_ALLOC_TAG rather than calling this yourself. */
+	alloc_tag::Enum v_set_alloc_tag(alloc_tag::Enum tag);
+	const char *v_alloc_tag_name(alloc_tag::Enum tag);
+
+	struct alloc_tag_scope {
+		alloc_tag_scope(alloc_tag::Enum tag): prev(v_set_alloc_tag(tag)) {}
+		~alloc_tag_scope() { v_set_alloc_tag(prev); }
+		alloc_tag::Enum prev;
+	};
+
+#if VBEAT_HEAP_TRACKING
+#	define VBEAT_ALLOC_TAG(tag) vbeat::alloc_tag_scope _alloc_tag_scope(vbeat::alloc_tag::tag)
+
+	struct heap_tag_stats_t {
+		size_t live_bytes;
+		size_t live_count;
+		size_t frame_allocs; // during the last full frame
+		size_t frame_bytes;
+		size_t high_water;   // most live bytes at once
+	};
+
+	void v_heap_stats(heap_tag_stats_t (&stats)[alloc_tag::count]);
+
+	// Roll the per-frame counters over. Call once per frame.
+	void v_heap_frame();
+
+	// Print whatever is still alive, per tag.
+	void v_heap_report();
+#else
+#	define VBEAT_ALLOC_TAG(tag)
+#endif
+
+	/* While armed, any heap allocation made by a thread inside a no-alloc
+	 * scope gets reported along with a call stack (once per call stack).
+	 * The frame arena is fine, unless it spills. */
+	struct no_alloc_scope {
+		no_alloc_scope(const char *name);
+		~no_alloc_scope();
+		const char *prev;
+	};
+
+#if VBEAT_ALLOC_GUARD
+#	define VBEAT_NO_ALLOC_SCOPE(name) vbeat::no_alloc_scope _no_alloc_scope(name)
+
+	void v_set_alloc_guard(bool armed);
+	bool v_alloc_guard_armed();
+#else
+#	define VBEAT_NO_ALLOC_SCOPE(name)
+#endif
+
+	/* Per-frame linear allocator. Anything handed out here is released all at
+	 * once by the second v_frame_reset() after it, which the main loop calls
+	 * right after bgfx::frame(). That's just long enough for the render
+	 * thread to be done with it, so it's fine to bgfx::makeRef, but it's only
+	 * good for scratch data. Game thread only.
+	 *
+	 * If the arena runs dry we fall back to v_malloc; those blocks are also
+	 * released on reset, and show up in the stats so we can size it up. */
+	void *v_frame_alloc(size_t bytes);
+	void  v_frame_reset();
+
+	struct frame_stats_t {
+		size_t capacity;   // per frame
+		size_t used;       // arena bytes used this frame
+		size_t overflow;   // bytes that spilled to the heap this frame
+		size_t high_water; // worst used + overflow seen at any reset
+	};
+	frame_stats_t v_frame_stats();
+
 	// STL allocator, for things that need it.
 	// I'm not sure we need this if we're overriding global operators new & delete.
 	template <class T>
@@ -113,4 +234,78 @@ namespace vbeat {
 			return *this;
 		}
 	};
+
+	// STL allocator for the frame arena. deallocate is a no-op, the memory
+	// goes away at the next v_frame_reset().
+	template <class T>
+	class v_frame_allocator
+	{
+	public:
+		typedef size_t    size_type;
+		typedef ptrdiff_t difference_type;
+		typedef T*        pointer;
+		typedef const T*  const_pointer;
+		typedef T&        reference;
+		typedef const T&  const_reference;
+		typedef T         value_type;
+
+		v_frame_allocator() {}
+		v_frame_allocator(const v_frame_allocator&) {}
+
+		pointer allocate(size_type n, const void * = 0) {
+			return (T*)vbeat::v_frame_alloc(n * sizeof(T));
+		}
+
+		void deallocate(void*, size_type) {}
+
+		pointer address(reference x) const {
+			return &x;
+		}
+
+		const_pointer address(const_reference x) const {
+			return &x;
+		}
+
+		v_frame_allocator<T>& operator=(const v_frame_allocator&) {
+			return *this;
+		}
+
+		void construct(pointer p, const T& val) {
+			new ((T*) p) T(val);
+		}
+		void destroy(pointer p) {
+			p->~T();
+		}
+
+		size_type max_size() const {
+			return size_t(-1);
+		}
+
+		template <class U>
+		struct rebind {
+			typedef v_frame_allocator<U> other;
+		};
+
+		template <class U>
+		v_frame_allocator(const v_frame_allocator<U>&) {}
+
+		template <class U>
+		v_frame_allocator& operator=(const v_frame_allocator<U>&) {
+			return *this;
+		}
+
+		// there's only the one arena, so they're all interchangeable.
+		template <class U>
+		bool operator==(const v_frame_allocator<U>&) const {
+			return true;
+		}
+
+		template <class U>
+		bool operator!=(const v_frame_allocator<U>&) const {
+			return false;
+		}
+	};
+
+	template <class T>
+	using frame_vector = std::vector<T, v_frame_allocator<T>>;
 }
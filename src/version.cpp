@@ -0,0 +1,9 @@
+#include "version.hpp"
+
+#ifndef VBEAT_BUILD_ID
+#	define VBEAT_BUILD_ID __DATE__ " " __TIME__
+#endif
+
+const char *vbeat::build_id() {
+	return VBEAT_BUILD_ID;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace vbeat {
+	/* Which build this is, for anything that has to match up later (i.e.
+	 * replays). The build system can pass VBEAT_BUILD_ID (a commit hash,
+	 * say); otherwise it's when version.cpp was compiled. */
+	const char *build_id();
+} // vbeat
@@ -4,7 +4,9 @@
 
 #include "widgets/widget.hpp"
 #include "graphics/bitmap_font.hpp"
+#include "graphics/shader.hpp"
 #include "fs.hpp"
+#include "profiler.hpp"
 
 using namespace vbeat;
 
@@ -22,11 +24,7 @@ struct font_test_t : widget_t {
 
 	void init() {
 		sampler = bgfx::createUniform("s_tex_color", bgfx::UniformType::Int1);
-		dfield = bgfx::createProgram(
-			bgfx::createShader(fs::read_mem("shaders/sprite.vs.bin")),
-			bgfx::createShader(fs::read_mem("shaders/distance-field.fs.bin")),
-			true
-		);
+		dfield = graphics::load_program("shaders/sprite.vs.bin", "shaders/distance-field.fs.bin");
 
 		fnt = new bitmap_font_t();
 		fnt->load("fonts/helvetica-neue-55.fnt");
@@ -37,10 +35,12 @@ struct font_test_t : widget_t {
 	}
 
 	void update(double) {
+		VBEAT_PROFILE_SCOPE("font_test_t::update");
 		bx::mtxTranslate(text, 200, 200, 0);
 	}
 
-	void draw() {
+	void draw(double) {
+		VBEAT_PROFILE_SCOPE("font_test_t::draw");
 		bgfx::setTexture(0, sampler, fnt->texture->tex);
 		bgfx::setTransform(text);
 		bgfx::setVertexBuffer(fnt->vbo);
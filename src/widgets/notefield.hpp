@@ -1,11 +1,25 @@
 #pragma once
 
-#include <deque>
+#include <cmath>
+#include <ctime>
 #include <bx/fpumath.h>
 
 #include "widgets/widget.hpp"
 #include "graphics/sprite_batch.hpp"
+#include "graphics/shader.hpp"
+#include "graphics/note_mesh.hpp"
+#include "chart/chart.hpp"
+#include "chart/sm.hpp"
+#include "chart/binary.hpp"
+#include "game/judge.hpp"
+#include "game/replay.hpp"
+#include "game/practice.hpp"
+#include "game/session.hpp"
+#include "clock.hpp"
 #include "fs.hpp"
+#include "profiler.hpp"
+#include "settings.hpp"
+#include "version.hpp"
 
 using namespace vbeat;
 
@@ -30,26 +44,18 @@ void add_sprite(graphics::sprite_batch_t *batch, float x, float y, float *rect =
 		h = rect[3] - rect[1];
 	}
 
-	/*  [0] -----> [1]
-	*   ^  -\   A  |
-	*   |    -\    |
-	*   | B    -\  v
-	*  [3]<-------[2] */
-	std::vector<graphics::vertex_t> verts = {
-		{ 0.f + x, 0.f + y,           umin, vmin }, // top left
-		{ (float)w + x, 0.f + y,      umax, vmin }, // top right
-		{ (float)w + x, (float)h + y, umax, vmax }, // bottom right
-		{ 0.f + x, (float)h + y,      umin, vmax }  // bottom left
-	};
-	std::vector<uint16_t> indices = {
-		0, 1, 2,
-		0, 2, 3
-	};
-	batch->add(verts, indices);
+	// straight into the batch, in sprite_batch_t's corner order.
+	graphics::vertex_t *v = batch->add(1);
+	if (!v) {
+		return;
+	}
+	v[0].x = x;     v[0].y = y;     v[0].u = umin; v[0].v = vmin; // top left
+	v[1].x = x + w; v[1].y = y;     v[1].u = umax; v[1].v = vmin; // top right
+	v[2].x = x + w; v[2].y = y + h; v[2].u = umax; v[2].v = vmax; // bottom right
+	v[3].x = x;     v[3].y = y + h; v[3].u = umin; v[3].v = vmax; // bottom left
 };
 
-static uint32_t good = 200;
-static uint32_t great = 50;
+static float note_rect[] = { 2.f, 2.f, 22.f, 13.f };
 
 struct notefield_t : widget_t {
 	graphics::sprite_batch_t *receptors;
@@ -57,33 +63,66 @@ struct notefield_t : widget_t {
 	bgfx::UniformHandle sampler;
 	bgfx::ProgramHandle program;
 
+	// Static notes, if we have the shader for them.
+	graphics::note_mesh_t *note_mesh;
+	bgfx::ProgramHandle note_program;
+	bgfx::UniformHandle u_scroll;
+
 	float xform[16];
 
-	double time;
+	float  speed;
+	double note_spacing;
+
+	uint64_t total_ticks; // since we got here; the song started at epoch_ticks
+	uint64_t epoch_ticks;
+	uint32_t tick_rate;   // set before init()
+	float    view_height; // same, pixels
+
+	chart::chart_t chart;
+
+	// rows on screen
+	chart::cursor_t visible;
+
+	// lane that goes in the leftmost column: 1 for 4 lanes, 0 for 6.
+	int first_lane;
 
-	struct note_row_t {
-		uint32_t ms;
-		uint8_t  columns;
-	};
+	// where each row sits along the scroll, see scroll_pos
+	std::vector<double> row_pos;
 
-	struct judge_row_t {
-		note_row_t *row;
-		int16_t  offset;
-	};
+	// where the last scroll_pos lookup left off
+	size_t time_hint, scroll_hint;
 
-	std::vector<note_row_t> note_data;
-	std::vector<judge_row_t> judge_data;
-	std::deque<judge_row_t> judging;
+	// clock, judge and judgments; the same thing tools/verify runs.
+	game::session_t session;
+
+	// Seeking, loops and rate, see practice_key. Once any of it's used the
+	// play stops being recorded; a replay can't seek.
+	game::practice_t practice;
+	bool             practicing;
+	double           loop_mark;
+
+	// every play gets recorded; the last one can be played back through
+	// the same judging, in place of live input.
+	uint64_t              chart_hash;
+	game::replay_writer_t recorder;
+	game::replay_t        playback;
+	std::string           last_replay;
 
 	void init() {
 		sampler = bgfx::createUniform("s_tex_color", bgfx::UniformType::Int1);
-		program = bgfx::createProgram(
-			bgfx::createShader(fs::read_mem("shaders/sprite.vs.bin")),
-			bgfx::createShader(fs::read_mem("shaders/sprite.fs.bin")),
-			true
-		);
+		program = graphics::load_program("shaders/sprite.vs.bin", "shaders/sprite.fs.bin");
 		receptors = new graphics::sprite_batch_t(graphics::get_texture("buttons_oxygen.png"));
 		notes     = new graphics::sprite_batch_t(graphics::get_texture("notes_oxygen.png"));
+		note_mesh = new graphics::note_mesh_t(notes->texture);
+
+		note_program = BGFX_INVALID_HANDLE;
+		u_scroll     = BGFX_INVALID_HANDLE;
+		if (fs::is_file("shaders/note.vs.bin")) {
+			note_program = graphics::load_program("shaders/note.vs.bin", "shaders/sprite.fs.bin");
+			u_scroll     = bgfx::createUniform("u_scroll", bgfx::UniformType::Vec4);
+		} else {
+			puts("notefield: No shaders/note.vs.bin, building notes on the CPU.");
+		}
 
 		static float mbutton[] = { 22.f, 2.f, 38.f, 22.f };
 		// static float mbutton[] = { 2.f, 2.f, 22.f, 22.f };
@@ -112,119 +151,409 @@ struct notefield_t : widget_t {
 
 		receptors->buffer();
 
-		/*
-		 * columns is a bitfield.
-		 * 76543210
-		 * ||||||||
-		 * |||||||+-- reserved (6key)
-		 * |||++++--- notes
-		 * ||+------- reserved (6key)
-		 * ++-------- holds
-		 */
-		enum {
-			NOTE4_MASK = 0x1E,
-			NOTE6_MASK = 0x3F,
-			HOLD_MASK  = 0xC0
-		};
-		#define NOTE(x) 1<<x
-		note_data = std::vector<note_row_t> {
-			{ 250*2, NOTE(1) | NOTE(4) },
-			{ 400*2, NOTE(3) },
-			{ 550*2, NOTE(2) },
-			{ 700*2, NOTE(3) | NOTE(2) },
-			{ 950*2, NOTE(4) }
-		};
-		#undef NOTE
-
-		time = -1;
+		speed        = 4.f;
+		note_spacing = 32.0;
+
+		VBEAT_ALLOC_TAG(chart);
+		// something real if it's there, the built-in pattern otherwise.
+		if (!this->load_chart()) {
+			#define NOTE(x) 1<<x
+			chart.rows = std::vector<chart::note_row_t> {
+				{ 0.5f, 0, NOTE(1) | NOTE(4) },
+				{ 0.8f, 0, NOTE(3) },
+				{ 1.1f, 0, NOTE(2) },
+				{ 1.4f, 0, NOTE(3) | NOTE(2) },
+				{ 1.9f, 0, NOTE(4) }
+			};
+			#undef NOTE
+			chart.timing = chart::timing_t();
+			chart.timing.bpms.push_back({ 0.0, 60.0 });
+			chart.timing.build();
+			chart.compute_times();
+			chart.sort();
+		}
+
+		// all at once, the rows are in order so it's a straight walk.
+		row_pos.resize(chart.rows.size());
+		for (size_t i = 0; i < chart.rows.size(); i++) {
+			row_pos[i] = chart.rows[i].beat;
+		}
+		chart.timing.beats_to_scroll(row_pos.data(), row_pos.data(), row_pos.size());
+		time_hint   = 0;
+		scroll_hint = 0;
+
+		// anything in the outer two lanes means the whole 6 get laid out.
+		uint8_t lanes = 0;
+		for (auto &row : chart.rows) {
+			lanes |= row.columns & chart::NOTE6_MASK;
+		}
+		first_lane = (lanes & ~chart::NOTE4_MASK) ? 0 : 1;
+
+		visible.reset(&chart);
+		session.reset(&chart, tick_rate);
+		practice.reset(&session);
+		practicing = false;
+		loop_mark  = session.start_time;
+
+		if (bgfx::isValid(note_program)) {
+			build_note_mesh();
+		}
+
+		// receptors near the bottom, notes come up from there.
+		bx::mtxTranslate(xform, 50.f, view_height - 70.f, 0.f);
+
+		total_ticks = 0;
+		epoch_ticks = 0;
+
+		chart_hash = chart.hash();
+		this->begin_recording();
 	}
 
 	virtual ~notefield_t() {
 		bgfx::destroyProgram(program);
 		bgfx::destroyUniform(sampler);
+		if (bgfx::isValid(note_program)) {
+			bgfx::destroyProgram(note_program);
+			bgfx::destroyUniform(u_scroll);
+		}
+		delete note_mesh;
 		delete receptors;
 		delete notes;
+		recorder.close();
+	}
+
+	// From the top: judge, clock and notes back to the start.
+	void restart(bool playback) {
+		this->recorder.close();
+		this->epoch_ticks = this->total_ticks;
+		this->time_hint   = 0;
+		this->scroll_hint = 0;
+		this->visible.reset(&this->chart);
+		this->session.reset(&this->chart, this->tick_rate);
+		this->practice.reset(&this->session);
+		this->practicing = false;
+		this->loop_mark  = this->session.start_time;
+		if (playback) {
+			this->session.play_back(&this->playback);
+		} else {
+			this->begin_recording();
+		}
+	}
+
+	void begin_recording() {
+		game::replay_header_t h;
+		game::init_header(h, this->chart_hash, this->tick_rate);
+		h.visual_offset_ms = float(settings::get_double("visual_offset_ms", 0.0));
+		h.speed            = this->speed;
+
+		char filename[64];
+		snprintf(filename, sizeof(filename), "replays/%016llx-%lld.vbr",
+			(unsigned long long)this->chart_hash, (long long)::time(nullptr)
+		);
+		fs::make_dir("replays");
+		if (this->recorder.open(filename, h)) {
+			this->last_replay = filename;
+		}
+	}
+
+	// Play a recording back; it has to be of this chart at this tick rate.
+	bool play_back(const std::string &filename) {
+		this->recorder.close();
+		if (!this->playback.load(filename)) {
+			return false;
+		}
+		const game::replay_header_t &h = this->playback.header;
+		if (h.chart != this->chart_hash || h.tick_rate != this->tick_rate) {
+			printf("Replay: %s is for another chart or tick rate.\n", filename.c_str());
+			return false;
+		}
+		if (strcmp(h.build, build_id()) != 0) {
+			printf("Replay: Recorded by build \"%s\", this is \"%s\".\n", h.build, build_id());
+		}
+		if (this->playback.missing > 0) {
+			printf("Replay: %u events were lost while recording, this won't match.\n", this->playback.missing);
+		}
+		printf("Replay: Playing back %s (%u events).\n", filename.c_str(), unsigned(this->playback.events.size()));
+		this->restart(true);
+		return true;
+	}
+
+	// Recording I/O, kept out of the no-alloc scopes. Closes the file once
+	// the song's over.
+	void flush_replay() {
+		if (!this->recorder.is_open()) {
+			return;
+		}
+		if (this->session.song_over()) {
+			this->recorder.close();
+			printf("Replay: Saved %s.\n", this->recorder.filename.c_str());
+			this->print_tally();
+			return;
+		}
+		this->recorder.flush();
+	}
+
+	void print_tally() const {
+		const game::stats_t &s = this->session.stats;
+		printf("Result: %u perfect, %u great, %u good, %u miss\n",
+			s.tiers[game::tier::perfect], s.tiers[game::tier::great],
+			s.tiers[game::tier::good], s.tiers[game::tier::miss]
+		);
+		printf("Result: %.2f%%, max combo %u, mean %+.1fms, UR %.1f\n",
+			s.accuracy * 100.0, s.max_combo, s.mean, s.unstable_rate
+		);
+	}
+
+	void input(const input_event_t *events, size_t count) {
+		VBEAT_PROFILE_SCOPE("notefield_t::input");
+		VBEAT_NO_ALLOC_SCOPE("notefield_t::input");
+		for (size_t i = 0; i < count; i++) {
+			this->input(events[i]);
+		}
 	}
 
 	void input(const input_event_t &e) {
-		// cowbell simulator
-		if (e.key == SDLK_SPACE) {
-			int64_t now = uint64_t(this->time * 1000.0);
-			/* anything in this list is guaranteed to be a valid hit, so we just
-			 * need to compute the offset.
-			 *
-			 * TODO: we actually only want to use this input for the closest row */
-			for (auto &jr : this->judging) {
-				if (jr.offset != INT16_MIN) {
-					continue;
+		if (this->session.playback) {
+			return;
+		}
+		if (e.lane < 0) {
+			if (e.type == input_event_t::press) {
+				this->practice_key(e.key);
+			}
+			return;
+		}
+		// judge against when the key actually went down, not the last tick.
+		game::replay_event_t r;
+		r.tick   = uint32_t(this->session.ticks);
+		r.ms     = int32_t(floor(this->song_time(e.time) * 1000.0));
+		r.lane   = uint8_t(e.lane);
+		r.type   = e.type;
+		r.unused = 0;
+		this->recorder.record(r);
+		this->session.apply(r);
+		this->print_judgments();
+	}
+
+	// Whatever the judge decided since last time.
+	void print_judgments() {
+		auto &recent = this->session.recent;
+		for (; !recent.empty(); recent.pop()) {
+			const game::judgment_t &j = recent[0];
+			if (j.tier == game::tier::miss) {
+				printf("miss (lane %u)\n", unsigned(j.lane));
+			} else {
+				printf("%s! %dms (lane %u)\n", game::tier_name(game::tier::Enum(j.tier)), int(j.offset), unsigned(j.lane));
+			}
+		}
+	}
+
+	/* Left/right seek 5s, [ marks where a loop starts and ] loops from
+	 * there to here, backspace stops looping, -/= change the rate. */
+	void practice_key(SDL_Keycode key) {
+		game::session_t &s = this->session;
+		double t = s.time;
+		switch (key) {
+			case SDLK_LEFT:
+				t = t - 5.0 > s.start_time ? t - 5.0 : s.start_time;
+				this->begin_practice();
+				this->practice.seek(t);
+				break;
+			case SDLK_RIGHT:
+				this->begin_practice();
+				this->practice.seek(t + 5.0);
+				break;
+			case SDLK_LEFTBRACKET:
+				this->loop_mark = t;
+				break;
+			case SDLK_RIGHTBRACKET:
+				if (t <= this->loop_mark) {
+					break;
 				}
-				int64_t offset = jr.row->ms - now;
-				jr.offset = int16_t(offset);
-				printf("hit! %ldms\n", offset);
+				this->begin_practice();
+				this->practice.set_loop(this->loop_mark, t);
+				printf("Practice: Looping %.1fs-%.1fs\n", this->loop_mark, t);
+				break;
+			case SDLK_BACKSPACE:
+				this->practice.clear_loop();
+				break;
+			case SDLK_MINUS:
+			case SDLK_EQUALS: {
+				double rate = s.rate + (key == SDLK_MINUS ? -0.1 : 0.1);
+				rate = rate < 0.5 ? 0.5 : (rate > 2.0 ? 2.0 : rate);
+				this->begin_practice();
+				s.set_rate(rate);
+				printf("Practice: %.1fx\n", rate);
+				break;
 			}
+			default:
+				break;
 		}
 	}
 
-	void update(double dt) {
-		this->time += dt;
+	void begin_practice() {
+		if (this->practicing) {
+			return;
+		}
+		this->practicing = true;
+		if (this->recorder.is_open()) {
+			this->recorder.close();
+			printf("Practice: Not recording this play.\n");
+		}
+	}
 
-		float speed = 4;
-		static float note_rect[] = { 2.f, 2.f, 22.f, 13.f };
+	// The sim runs at session.tick_dt, which is what dt is anyway.
+	void update(double) {
+		VBEAT_PROFILE_SCOPE("notefield_t::update");
+		VBEAT_NO_ALLOC_SCOPE("notefield_t::update");
+		this->total_ticks += 1;
+		this->session.tick();
+		if (!this->session.playback) {
+			this->practice.update();
+		}
+		this->print_judgments();
 
-		bx::mtxTranslate(xform, 50, 650, 0);
-		notes->clear();
+		if (this->session.done()) {
+			this->session.playback = nullptr;
+			printf("Replay: Done.\n");
+			if (this->session.rejected > 0) {
+				printf("Replay: %u events couldn't have been played live, skipped them.\n", this->session.rejected);
+			}
+			this->print_tally();
+		}
+	}
 
-		float width    = note_rect[2] - note_rect[0];
-		float spacing  = 6.f;
-		float x_offset = -26.0f;
-		uint32_t now = uint32_t(this->time * 1000.0);
-
-		for (auto &row : this->note_data) {
-			uint32_t earliest_row = now - good;
-			uint32_t latest_row   = now + good;
-
-			// Send anything out of range into our final judge data.
-			while (!this->judging.empty()
-				&& this->judging.front().row->ms < earliest_row
-			) {
-				judge_row_t &judge_row = this->judging.front();
-				if (judge_row.offset == INT16_MIN) {
-					puts("miss");
-				}
-				this->judge_data.push_back(this->judging.front());
-				this->judging.pop_front();
+	// Song time at a clock::now() stamp. Tick 0 is the clock's epoch, and
+	// the song (re)started epoch_ticks after that.
+	double song_time(uint64_t stamp) const {
+		double tick = clock::to_seconds(stamp) / this->session.tick_dt - double(this->epoch_ticks);
+		return this->session.time_at(tick);
+	}
+
+	// Where a lane's notes go across.
+	float note_x(int lane) const {
+		static const float note_width = note_rect[2] - note_rect[0];
+		int column = lane - this->first_lane + 1;
+		return (note_width + 6.f) * column - 26.f;
+	}
+
+	/* Where along the scroll a song time is: beats, slowed down or sped up
+	 * by scroll segments and held by stops. Called with about the same time
+	 * every frame, so the hints keep it O(1). */
+	double scroll_pos(double song_time) {
+		double beat = this->chart.timing.time_to_beat(song_time, this->time_hint);
+		return this->chart.timing.beat_to_scroll(beat, this->scroll_hint);
+	}
+
+	// pixels per unit of scroll_pos, i.e. per beat at scroll 1.
+	double scroll_scale() const {
+		return note_spacing * speed;
+	}
+
+	// Point the visible cursor at everything from the receptors to the top
+	// of the screen.
+	void seek_visible(double visual_time, double pos) {
+		const chart::timing_t &timing = this->chart.timing;
+		// where draw puts the receptors, plus a note so one half off the top counts.
+		double  above = double(this->xform[13]) + double(note_rect[3] - note_rect[1]);
+		double  top   = timing.beat_to_time(timing.scroll_to_beat(pos + above / this->scroll_scale()));
+		// the scroll can stop for good, and then everything is on screen.
+		top = top < 1e7 ? top : 1e7;
+		int64_t from = int64_t(ceil(visual_time * 1000.0));
+		int64_t to   = int64_t(ceil(top * 1000.0));
+		this->visible.seek(from, to > from ? to : from);
+	}
+
+	// songs/test.vbc, or the .sm it came from.
+	bool load_chart() {
+		static const char *files[] = { "songs/test.vbc", "songs/test.sm" };
+		for (auto file : files) {
+			chart::metadata_t meta;
+			if (fs::is_file(file) && chart::load_chart(file, this->chart, 0, &meta)) {
+				printf("Chart: %s, %u rows\n", meta.title, unsigned(this->chart.rows.size()));
+				return true;
 			}
+		}
+		return false;
+	}
 
-			// Add anything ahead in range to our judge list
-			if (row.ms > earliest_row && row.ms < latest_row) {
-				if (this->judging.empty()
-					|| this->judging.back().row->ms < row.ms
-				) {
-					judge_row_t judge_row = { &row, INT16_MIN };
-					this->judging.push_back(judge_row);
+	/* Every note in the chart, once, into static buffers. From then on the
+	 * VS scrolls them and all draw does is set u_scroll. */
+	void build_note_mesh() {
+		VBEAT_ALLOC_TAG(mesh);
+		std::vector<graphics::note_vertex_t> vertices;
+		std::vector<uint8_t> quads_per_row(this->chart.rows.size(), 0);
+
+		const graphics::texture_t *tex = note_mesh->texture;
+		float w = note_rect[2] - note_rect[0];
+		float h = note_rect[3] - note_rect[1];
+		float umin = note_rect[0] / tex->w, umax = note_rect[2] / tex->w;
+		float vmin = note_rect[1] / tex->h, vmax = note_rect[3] / tex->h;
+
+		for (size_t r = 0; r < this->chart.rows.size(); r++) {
+			const chart::note_row_t &row = this->chart.rows[r];
+			float pos = float(this->row_pos[r]);
+			// no hold bodies yet, so nothing to draw for the end of one.
+			if (row.columns & chart::HOLD_TAIL) {
+				continue;
+			}
+			uint8_t lanes = row.columns & chart::NOTE6_MASK;
+			for (int i = 0; i < 6; ++i) {
+				if (!((lanes >> i) & 0x1)) {
+					continue;
 				}
+				float x = this->note_x(i);
+				// same winding as add_sprite
+				graphics::note_vertex_t quad[4] = {
+					{ x,     0.f, umin, vmin, pos, 0.f },
+					{ x + w, 0.f, umax, vmin, pos, 0.f },
+					{ x + w, h,   umax, vmax, pos, 0.f },
+					{ x,     h,   umin, vmax, pos, 0.f }
+				};
+				vertices.insert(vertices.end(), quad, quad + 4);
+				quads_per_row[r] += 1;
 			}
+		}
 
-			double note_spacing = 32.0;
-			double y = note_spacing * speed * -(double(row.ms) / 1000.0 - this->time);
-			if (y > 0.0) {
+		note_mesh->build(vertices.data(), vertices.size() / 4, quads_per_row.data(), quads_per_row.size());
+	}
+
+	// CPU fallback when note.vs.bin isn't around: lay out the visible notes
+	// for a given song time every frame.
+	void build_notes(double visual_time) {
+		notes->clear();
+
+		double pos = this->scroll_pos(visual_time);
+		this->seek_visible(visual_time, pos);
+
+		for (size_t r = this->visible.begin; r < this->visible.end; r++) {
+			const chart::note_row_t &row = this->chart.rows[r];
+			if (row.columns & chart::HOLD_TAIL) {
 				continue;
 			}
+			double y = this->scroll_scale() * -(this->row_pos[r] - pos);
 
-			for (uint8_t i = 1; i < 5; ++i) {
-				uint8_t note = (row.columns >> i) & 0x1;
+			uint8_t lanes = row.columns & chart::NOTE6_MASK;
+			for (int i = 0; i < 6; ++i) {
+				uint8_t note = (lanes >> i) & 0x1;
 				if (!note) {
 					continue;
 				}
-				float x = (width + spacing) * i + x_offset;
-				add_sprite(notes, x, float(y), note_rect);
+				add_sprite(notes, this->note_x(i), float(y), note_rect);
 			}
 		}
 
 		notes->buffer();
 	}
 
-	void draw() {
+	void draw(double alpha) {
+		VBEAT_PROFILE_SCOPE("notefield_t::draw");
+		this->flush_replay();
+
+		VBEAT_NO_ALLOC_SCOPE("notefield_t::draw");
+		// Scrolling is linear in time, so placing the notes for the predicted
+		// present time is exact, even well past the last tick.
+		double visual_time = this->session.time + alpha * this->session.tick_dt * this->session.rate;
+
 		uint64_t state = 0
 			| BGFX_STATE_RGB_WRITE
 			| BGFX_STATE_CULL_CCW
@@ -232,17 +561,28 @@ struct notefield_t : widget_t {
 			| BGFX_STATE_DEPTH_WRITE
 			| BGFX_STATE_BLEND_ALPHA;
 
-		bgfx::setTexture(0, sampler, notes->texture->tex);
-		bgfx::setTransform(xform);
-		bgfx::setVertexBuffer(notes->vbo);
-		bgfx::setIndexBuffer(notes->ibo, 0, notes->indices.size());
-		bgfx::setState(state);
-		bgfx::submit(0, program);
+		if (bgfx::isValid(note_program)) {
+			double pos = this->scroll_pos(visual_time);
+			this->seek_visible(visual_time, pos);
+			float scroll[4] = { float(pos), float(this->scroll_scale()), 0.f, 0.f };
+			bgfx::setUniform(u_scroll, scroll);
+			bgfx::setTexture(0, sampler, note_mesh->texture->tex);
+			bgfx::setTransform(xform);
+			note_mesh->submit(0, note_program, state, this->visible.begin, this->visible.end);
+		} else {
+			build_notes(visual_time);
+			bgfx::setTexture(0, sampler, notes->texture->tex);
+			bgfx::setTransform(xform);
+			bgfx::setVertexBuffer(notes->vbo);
+			bgfx::setIndexBuffer(notes->ibo, 0, notes->num_indices);
+			bgfx::setState(state);
+			bgfx::submit(0, program);
+		}
 
 		bgfx::setTexture(0, sampler, receptors->texture->tex);
 		bgfx::setTransform(xform);
 		bgfx::setVertexBuffer(receptors->vbo);
-		bgfx::setIndexBuffer(receptors->ibo, 0, receptors->indices.size());
+		bgfx::setIndexBuffer(receptors->ibo, 0, receptors->num_indices);
 		bgfx::setState(state);
 		bgfx::submit(0, program);
 	}
@@ -1,9 +1,24 @@
 #pragma once
 
 #include <SDL2/SDL_keycode.h>
+#include <cstdint>
 
 struct input_event_t {
-	SDL_Keycode key;
+	enum type_t {
+		press,
+		release
+	};
+
+	enum {
+		keyboard = 0 // joysticks are 1 + their instance id
+	};
+
+	uint8_t     type;
+	uint8_t     device;
+	int8_t      lane;   // -1 if it isn't bound to one
+	uint8_t     button; // joysticks
+	SDL_Keycode key;    // keyboard
+	uint64_t    time;   // clock::now() when it arrived, not when we got to it
 };
 
 struct widget_t {
@@ -13,7 +28,16 @@ struct widget_t {
 	virtual ~widget_t() {}
 
 	virtual void init() {}
-	virtual void input(const input_event_t &) {};
+
+	// Everything that happened since the last batch, oldest first.
+	virtual void input(const input_event_t *, size_t) {};
+
+	// Called at the fixed simulation rate, so dt never changes.
 	virtual void update(double dt) = 0;
-	virtual void draw() = 0;
+
+	/* Called once per frame. alpha is where the frame will be when it hits
+	 * the screen, in ticks past the last one. That's usually a tick or more
+	 * ahead, so expect > 1 and extrapolate; it can go negative with a
+	 * visual offset. */
+	virtual void draw(double alpha) = 0;
 };
@@ -0,0 +1,279 @@
+/* allocbench: replay a recorded allocation trace against our allocator and
+ * the CRT's, to see what the pool buys us.
+ *
+ *   allocbench [--threads N] [--repeat N] alloc.trace
+ *
+ * Record the trace with a VBEAT_ALLOC_TRACE build (genie --alloc-trace); it
+ * writes alloc.trace to the working directory. Every thread replays the
+ * whole trace, all of them at once, so N threads means N times the traffic
+ * fighting over the same heap, the way loader threads would. Each block is
+ * touched once after it's handed out. Reports throughput over the run and
+ * the latency of single calls. Plain stdio for the trace, so it needs no
+ * more of the game than the allocator. */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <SDL2/SDL.h>
+#include <bx/crtimpl.h>
+
+#include "vbeat.hpp"
+#include "allocator.hpp"
+
+using namespace vbeat;
+
+namespace {
+	bool read_file(const char *filename, std::vector<uint8_t> &data) {
+		FILE *f = fopen(filename, "rb");
+		if (!f) {
+			return false;
+		}
+		fseek(f, 0, SEEK_END);
+		long size = ftell(f);
+		fseek(f, 0, SEEK_SET);
+		data.resize(size_t(size > 0 ? size : 0));
+		bool ok = data.empty() || fread(&data[0], 1, data.size(), f) == data.size();
+		fclose(f);
+		return ok;
+	}
+
+	// Latencies past this many counter ticks all land in the last bin.
+	const uint32_t latency_bins = 1 << 16;
+
+	struct op_t {
+		uint32_t slot;  // stands in for the recorded pointer
+		uint32_t size;
+		uint16_t align;
+		uint8_t  op;    // alloc_trace_t::op_alloc/free
+		uint8_t  unused;
+	};
+
+	struct trace_t {
+		std::vector<op_t> ops;
+		uint32_t slots;   // most blocks live at once
+		uint32_t threads; // that recorded it
+		uint32_t skipped; // frees of blocks from before the trace started
+	};
+
+	struct runner_t {
+		bx::AllocatorI       *allocator;
+		const trace_t        *trace;
+		uint32_t              repeat;
+		SDL_atomic_t         *go;
+		std::vector<void*>    slots;
+		std::vector<uint32_t> latency; // counts per bin
+		uint64_t              start, end;
+		SDL_Thread           *thread;
+	};
+
+	/* Recorded pointers get turned into slot numbers, reused as blocks are
+	 * freed, so a replay only needs an array. Whatever the trace leaves
+	 * live is freed at the end, so every round starts from nothing. */
+	bool load_trace(const std::string &filename, trace_t &trace) {
+		std::vector<uint8_t> data;
+		if (!read_file(filename.c_str(), data)) {
+			return false;
+		}
+		size_t n = data.size() / sizeof(alloc_trace_t);
+		const alloc_trace_t *events = (const alloc_trace_t*)data.data();
+
+		std::unordered_map<uint64_t, uint32_t> live;
+		std::vector<uint32_t> free_slots;
+		std::vector<uint16_t> aligns;
+		trace.ops.clear();
+		trace.ops.reserve(n);
+		trace.slots   = 0;
+		trace.threads = 0;
+		trace.skipped = 0;
+
+		for (size_t i = 0; i < n; i++) {
+			const alloc_trace_t &e = events[i];
+			if (e.thread > trace.threads) {
+				trace.threads = e.thread;
+			}
+
+			op_t op;
+			memset(&op, 0, sizeof(op));
+			op.op = e.op;
+			if (e.op == alloc_trace_t::op_alloc) {
+				if (free_slots.empty()) {
+					free_slots.push_back(trace.slots++);
+					aligns.push_back(0);
+				}
+				op.slot  = free_slots.back();
+				op.size  = e.size;
+				op.align = e.align > 0 ? uint16_t(1 << e.align) : 0;
+				free_slots.pop_back();
+				aligns[op.slot] = op.align;
+				live[e.ptr] = op.slot;
+			} else {
+				auto it = live.find(e.ptr);
+				if (it == live.end()) {
+					trace.skipped += 1;
+					continue;
+				}
+				op.slot  = it->second;
+				op.align = aligns[op.slot]; // the CRT wants it back
+				free_slots.push_back(op.slot);
+				live.erase(it);
+			}
+			trace.ops.push_back(op);
+		}
+
+		for (auto &l : live) {
+			op_t op;
+			memset(&op, 0, sizeof(op));
+			op.op    = alloc_trace_t::op_free;
+			op.slot  = l.second;
+			op.align = aligns[op.slot];
+			trace.ops.push_back(op);
+		}
+		return true;
+	}
+
+	int run_main(void *data) {
+		runner_t &r = *(runner_t*)data;
+		const std::vector<op_t> &ops = r.trace->ops;
+		void **slots = r.slots.data();
+		uint32_t *latency = r.latency.data();
+
+		while (SDL_AtomicGet(r.go) == 0) {
+			// everyone starts together
+		}
+
+		r.start = SDL_GetPerformanceCounter();
+		for (uint32_t round = 0; round < r.repeat; round++) {
+			for (size_t i = 0; i < ops.size(); i++) {
+				const op_t &op = ops[i];
+				uint64_t begin = SDL_GetPerformanceCounter();
+				if (op.op == alloc_trace_t::op_alloc) {
+					uint8_t *ptr = (uint8_t*)r.allocator->realloc(nullptr, op.size, op.align, nullptr, 0);
+					if (ptr) {
+						ptr[0] = 0;
+					}
+					slots[op.slot] = ptr;
+				} else {
+					r.allocator->realloc(slots[op.slot], 0, op.align, nullptr, 0);
+					slots[op.slot] = nullptr;
+				}
+				uint64_t ticks = SDL_GetPerformanceCounter() - begin;
+				latency[ticks < latency_bins ? ticks : latency_bins - 1] += 1;
+			}
+		}
+		r.end = SDL_GetPerformanceCounter();
+
+		pool_allocator_t::flush_thread_cache();
+		return 0;
+	}
+
+	uint32_t percentile(const std::vector<uint64_t> &bins, uint64_t total, double p) {
+		uint64_t want = uint64_t(double(total) * p);
+		uint64_t seen = 0;
+		for (uint32_t i = 0; i < bins.size(); i++) {
+			seen += bins[i];
+			if (seen > want) {
+				return i;
+			}
+		}
+		return uint32_t(bins.size() - 1);
+	}
+
+	void bench(const char *name, bx::AllocatorI *allocator, const trace_t &trace, uint32_t threads, uint32_t repeat) {
+		SDL_atomic_t go;
+		SDL_AtomicSet(&go, 0);
+
+		// all the setup up front, so the runs only allocate what they replay.
+		std::vector<runner_t> runners(threads);
+		for (auto &r : runners) {
+			r.allocator = allocator;
+			r.trace     = &trace;
+			r.repeat    = repeat;
+			r.go        = &go;
+			r.slots.assign(trace.slots, nullptr);
+			r.latency.assign(latency_bins, 0);
+			r.start     = 0;
+			r.end       = 0;
+		}
+		for (auto &r : runners) {
+			r.thread = SDL_CreateThread(run_main, "allocbench", &r);
+		}
+		SDL_AtomicSet(&go, 1);
+
+		uint64_t start = UINT64_MAX, end = 0;
+		std::vector<uint64_t> bins(latency_bins, 0);
+		for (auto &r : runners) {
+			SDL_WaitThread(r.thread, nullptr);
+			start = r.start < start ? r.start : start;
+			end   = r.end > end ? r.end : end;
+			for (uint32_t i = 0; i < latency_bins; i++) {
+				bins[i] += r.latency[i];
+			}
+		}
+
+		uint64_t ops = uint64_t(trace.ops.size()) * repeat * threads;
+		double freq = double(SDL_GetPerformanceFrequency());
+		double seconds = double(end - start) / freq;
+		double ns = 1e9 / freq;
+		printf("Allocbench: %-4s %2u threads: %7.2fM ops/s, p50 %5.0fns, p99 %6.0fns, p99.9 %6.0fns\n",
+			name, threads, double(ops) / seconds / 1e6,
+			double(percentile(bins, ops, 0.5)) * ns,
+			double(percentile(bins, ops, 0.99)) * ns,
+			double(percentile(bins, ops, 0.999)) * ns
+		);
+	}
+}
+
+int main(int argc, char **argv) {
+	uint32_t    threads = 0;
+	uint32_t    repeat  = 1;
+	std::string filename;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = uint32_t(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+			repeat = uint32_t(atoi(argv[++i]));
+		} else if (argv[i][0] == '-' || !filename.empty()) {
+			filename.clear();
+			break;
+		} else {
+			filename = argv[i];
+		}
+	}
+	if (filename.empty()) {
+		printf("usage: %s [--threads N] [--repeat N] alloc.trace\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (threads == 0) {
+		threads = uint32_t(SDL_GetCPUCount());
+	}
+	if (repeat == 0) {
+		repeat = 1;
+	}
+
+	trace_t trace;
+	if (!load_trace(filename, trace)) {
+		printf("Allocbench: Couldn't read %s.\n", filename.c_str());
+		return EXIT_FAILURE;
+	}
+	printf("Allocbench: %u ops recorded on %u threads, %u blocks live at most (%u frees of older blocks left out).\n",
+		unsigned(trace.ops.size()), trace.threads, trace.slots, trace.skipped
+	);
+	if (trace.ops.empty()) {
+		return EXIT_FAILURE;
+	}
+
+	pool_allocator_t pool;
+	bx::CrtAllocator crt;
+
+	// one thread first for the uncontended cost, then the lot.
+	bench("pool", &pool, trace, 1, repeat);
+	bench("crt", &crt, trace, 1, repeat);
+	if (threads > 1) {
+		bench("pool", &pool, trace, threads, repeat);
+		bench("crt", &crt, trace, threads, repeat);
+	}
+	return EXIT_SUCCESS;
+}
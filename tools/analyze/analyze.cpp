@@ -0,0 +1,209 @@
+/* analyze: fill in chart metrics for the whole library, headless.
+ *
+ *   analyze [--threads N] [--all] [--root songs] [--index library.idx]
+ *
+ * Brings the library index up to date the same way the game does, then
+ * loads every chart that hasn't been analyzed yet (all of them with --all)
+ * and writes the index back. Both the scan and the analysis run across one
+ * thread pool, and a song's file is parsed once for all its charts. Each
+ * worker keeps one set of buffers and reuses them, so memory goes with the
+ * thread count, not the library size. */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "vbeat.hpp"
+#include "clock.hpp"
+#include "fs.hpp"
+#include "thread_pool.hpp"
+#include "chart/analysis.hpp"
+#include "chart/binary.hpp"
+#include "chart/library.hpp"
+
+using namespace vbeat;
+
+namespace {
+	// Past this, a worker's buffers are freed after the job rather than kept.
+	const size_t max_keep_bytes = 16 << 20;
+	const size_t max_keep_rows  = 1 << 20;
+
+	struct worker_t {
+		std::vector<uint8_t> text;
+		chart::binary_t      bin;
+		chart::song_t       *song;
+		chart::chart_t       chart;     // .vbc, one at a time
+		chart::chart_t      *charts_sm; // .sm/.ssc, song_t::max_charts of them
+		uint32_t             charts;
+		uint32_t             failed;
+	};
+
+	bool ends_with(const char *s, const char *suffix) {
+		size_t a = strlen(s), b = strlen(suffix);
+		if (a < b) {
+			return false;
+		}
+		for (size_t i = 0; i < b; i++) {
+			char c = s[a - b + i];
+			if (c >= 'A' && c <= 'Z') {
+				c += 'a' - 'A';
+			}
+			if (c != suffix[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void analyze_song(chart::library_t &lib, const std::string &root, uint32_t index, bool all, worker_t &w) {
+		const chart::library_song_t &s = lib.songs[index];
+		std::string filename = root + "/" + s.folder + "/" + s.file;
+		bool vbc = ends_with(s.file, ".vbc");
+		bool ssc = ends_with(s.file, ".ssc");
+
+		bool ok = vbc
+			? fs::read_vector(w.bin.data, filename) && w.bin.open()
+			: fs::read_vector(w.text, filename);
+		if (!ok) {
+			printf("Analyze: Couldn't load %s.\n", filename.c_str());
+			w.failed += s.num_charts;
+			return;
+		}
+
+		// every chart out of one pass; the jobs only have songs with work left.
+		if (!vbc) {
+			chart::parse_sm_charts((const char*)w.text.data(), w.text.size(), ssc, *w.song, w.charts_sm);
+		}
+
+		for (uint32_t c = 0; c < s.num_charts; c++) {
+			chart::library_chart_t &lc = lib.charts[s.first_chart + c];
+			if (lc.analyzed && !all) {
+				continue;
+			}
+			// nothing we can play, nothing to measure; don't try again.
+			if (lc.info.columns == 0) {
+				memset(&lc.metrics, 0, sizeof(lc.metrics));
+				lc.analyzed = 1;
+				continue;
+			}
+
+			// the index and the file disagree if the file changed since the scan.
+			const chart::chart_t *target = &w.chart;
+			if (vbc) {
+				ok = w.bin.decode(c, w.chart);
+			} else {
+				target = &w.charts_sm[c];
+				ok = c < w.song->num_charts && w.song->charts[c].columns > 0;
+			}
+			if (!ok) {
+				w.failed += 1;
+				continue;
+			}
+			chart::analyze(*target, lc.metrics);
+			lc.analyzed = 1;
+			w.charts += 1;
+		}
+
+		// one huge file shouldn't pin that much memory for the rest of the run.
+		if (w.text.capacity() > max_keep_bytes) {
+			std::vector<uint8_t>().swap(w.text);
+		}
+		if (w.bin.data.capacity() > max_keep_bytes) {
+			std::vector<uint8_t>().swap(w.bin.data);
+		}
+		if (w.chart.rows.capacity() > max_keep_rows) {
+			std::vector<chart::note_row_t>().swap(w.chart.rows);
+		}
+		for (int c = 0; c < chart::song_t::max_charts; c++) {
+			if (w.charts_sm[c].rows.capacity() > max_keep_rows) {
+				std::vector<chart::note_row_t>().swap(w.charts_sm[c].rows);
+			}
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	clock::init();
+
+	uint32_t    threads = 0;
+	bool        all     = false;
+	std::string root    = "songs";
+	std::string index   = "library.idx";
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = uint32_t(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--all") == 0) {
+			all = true;
+		} else if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+			root = argv[++i];
+		} else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+			index = argv[++i];
+		} else {
+			printf("usage: %s [--threads N] [--all] [--root songs] [--index library.idx]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	fs::state vfs(argv[0]);
+
+	uint64_t start = clock::now();
+
+	thread_pool_t pool;
+	pool.init(threads);
+
+	chart::library_t cached, lib;
+	cached.load(index);
+	uint32_t read = lib.scan(root, cached, &pool);
+	cached = chart::library_t();
+	printf("Analyze: %u songs, %u read again.\n", unsigned(lib.songs.size()), read);
+
+	// only songs with something left to do.
+	std::vector<uint32_t> jobs;
+	for (uint32_t i = 0; i < lib.songs.size(); i++) {
+		const chart::library_song_t &s = lib.songs[i];
+		for (uint32_t c = 0; c < s.num_charts; c++) {
+			if (all || !lib.charts[s.first_chart + c].analyzed) {
+				jobs.push_back(i);
+				break;
+			}
+		}
+	}
+
+	uint32_t num_workers = pool.size();
+	std::vector<worker_t> workers(num_workers);
+	for (auto &w : workers) {
+		w.song      = new chart::song_t();
+		w.charts_sm = new chart::chart_t[chart::song_t::max_charts];
+		w.charts    = 0;
+		w.failed = 0;
+	}
+
+	/* Every job writes only its own song's charts, and nothing moves the
+	 * arrays while this runs, so there's nothing to lock. */
+	pool.run(uint32_t(jobs.size()), [&](uint32_t job, uint32_t worker) {
+		analyze_song(lib, root, jobs[job], all, workers[worker]);
+	});
+	pool.shutdown();
+
+	uint32_t charts = 0, failed = 0;
+	for (auto &w : workers) {
+		charts += w.charts;
+		failed += w.failed;
+		delete w.song;
+		delete[] w.charts_sm;
+	}
+	workers.clear();
+
+	double seconds = double(clock::now() - start) / double(clock::frequency());
+	printf("Analyze: %u charts from %u songs on %u threads in %.1fs (%u failed).\n",
+		charts, unsigned(jobs.size()), num_workers, seconds, failed
+	);
+
+	if (!lib.save(index)) {
+		printf("Analyze: Couldn't save %s.\n", index.c_str());
+		return EXIT_FAILURE;
+	}
+	return failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+/* chartc: .sm/.ssc in, .vbc out.
+ *
+ *   chartc song.ssc [song.vbc]
+ *
+ * Plain stdio, no VFS, so it runs anywhere. */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "chart/sm.hpp"
+#include "chart/binary.hpp"
+
+using namespace vbeat;
+
+namespace {
+	bool read_file(const char *filename, std::vector<char> &data) {
+		FILE *f = fopen(filename, "rb");
+		if (!f) {
+			return false;
+		}
+		fseek(f, 0, SEEK_END);
+		long size = ftell(f);
+		fseek(f, 0, SEEK_SET);
+		data.resize(size_t(size > 0 ? size : 0));
+		bool ok = data.empty() || fread(&data[0], 1, data.size(), f) == data.size();
+		fclose(f);
+		return ok;
+	}
+
+	bool write_file(const std::string &filename, const std::vector<uint8_t> &data) {
+		FILE *f = fopen(filename.c_str(), "wb");
+		if (!f) {
+			return false;
+		}
+		bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+		return fclose(f) == 0 && ok;
+	}
+
+	bool ends_with(const std::string &s, const char *suffix) {
+		size_t n = strlen(suffix);
+		if (s.size() < n) {
+			return false;
+		}
+		for (size_t i = 0; i < n; i++) {
+			char c = s[s.size() - n + i];
+			if (c >= 'A' && c <= 'Z') {
+				c += 'a' - 'A';
+			}
+			if (c != suffix[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		printf("usage: %s <chart.sm|chart.ssc> [out.vbc]\n", argv[0]);
+		return 1;
+	}
+
+	std::string in = argv[1];
+	std::string out;
+	if (argc > 2) {
+		out = argv[2];
+	} else {
+		size_t dot = in.find_last_of('.');
+		out = in.substr(0, dot) + ".vbc";
+	}
+
+	std::vector<char> text;
+	if (!read_file(in.c_str(), text)) {
+		printf("Couldn't read %s\n", in.c_str());
+		return 1;
+	}
+	bool ssc = ends_with(in, ".ssc");
+
+	/* Every chart in one pass. Ones we can't play come out empty, and keep
+	 * their entry so the list matches the source. */
+	chart::song_t *song = new chart::song_t();
+	std::vector<chart::chart_t> charts(chart::song_t::max_charts);
+	chart::parse_sm_charts(text.data(), text.size(), ssc, *song, charts.data());
+	uint32_t n = song->num_charts;
+
+	std::vector<uint8_t> data;
+	if (!chart::write_binary(*song, charts.data(), data) || !write_file(out, data)) {
+		printf("Couldn't write %s\n", out.c_str());
+		delete song;
+		return 1;
+	}
+
+	printf("%s: %s, %u charts, %u bytes\n", out.c_str(), song->meta.title, n, unsigned(data.size()));
+	for (uint32_t i = 0; i < n; i++) {
+		const chart::chart_info_t &info = song->charts[i];
+		printf("  %-16s %-10s %3d  %u rows\n", info.steps_type, info.difficulty, info.meter, unsigned(charts[i].rows.size()));
+	}
+	delete song;
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include <cstring>
+
+#include "tests.hpp"
+#include "chart/sm.hpp"
+#include "game/session.hpp"
+
+using namespace vbeat;
+
+namespace {
+	// 60 BPM from 0: a note in lane 1 at 0ms and one in lane 2 at 4000ms.
+	const char *two_notes =
+		"#OFFSET:0;\n"
+		"#BPMS:0=60;\n"
+		"#NOTES:dance-single::Hard:1::\n"
+		"1000\n0000\n0000\n0000\n,\n"
+		"0100\n0000\n0000\n0000\n"
+		";\n";
+
+	const uint32_t tick_rate = 1000;
+
+	game::replay_event_t press(uint32_t tick, int32_t ms, uint8_t lane) {
+		game::replay_event_t e;
+		e.tick   = tick;
+		e.ms     = ms;
+		e.lane   = lane;
+		e.type   = game::REPLAY_PRESS;
+		e.unused = 0;
+		return e;
+	}
+
+	void play(const chart::chart_t &chart, const game::replay_t &replay, game::session_t &session) {
+		session.reset(&chart, tick_rate);
+		session.play_back(&replay);
+		while (!session.done()) {
+			session.tick();
+		}
+	}
+
+	/* Songs start a second in, so the tick for song ms t is t + 1000. A
+	 * press stamped inside one tick but handed over a few later is still
+	 * what a live play does. */
+	void late_delivery() {
+		chart::song_t *song = new chart::song_t();
+		chart::chart_t chart;
+		VBEAT_CHECK(chart::parse_sm(two_notes, strlen(two_notes), false, *song, &chart, 0));
+
+		game::replay_t replay;
+		memset(&replay.header, 0, sizeof(replay.header));
+		replay.missing = 0;
+		replay.events.push_back(press(1001, 0, 1));    // one tick late
+		replay.events.push_back(press(5003, 4000, 2)); // three
+
+		game::session_t *session = new game::session_t();
+		play(chart, replay, *session);
+		VBEAT_CHECK(session->rejected == 0);
+		VBEAT_CHECK(session->stats.tiers[game::tier::perfect] == 2);
+
+		// stamped before the press ahead of it, or after the tick it came before.
+		replay.events[1] = press(5003, -5, 2);
+		replay.events.push_back(press(5003, 4010, 2));
+		play(chart, replay, *session);
+		VBEAT_CHECK(session->rejected == 2);
+
+		delete session;
+		delete song;
+	}
+}
+
+void tests::run_session() {
+	late_delivery();
+}
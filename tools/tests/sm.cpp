@@ -0,0 +1,44 @@
+#include <cstring>
+#include <string>
+
+#include "tests.hpp"
+#include "chart/sm.hpp"
+
+using namespace vbeat;
+
+namespace {
+	/* The file's text followed by more digits, handed over without them:
+	 * anything reading past the end picks them up. */
+	void unterminated_last_value() {
+		const char *text = "#BPMS:0=120;\n#OFFSET:0.25";
+		std::string buffer = std::string(text) + "99;";
+
+		chart::song_t *song = new chart::song_t();
+		VBEAT_CHECK(chart::parse_sm(buffer.data(), strlen(text), false, *song));
+		VBEAT_CHECK(song->timing.offset == -0.25);
+		delete song;
+	}
+
+	// Holds make up to three rows a line; the reserve has to cover them.
+	void holds_fit_the_reserve() {
+		const char *text =
+			"#BPMS:0=120;\n"
+			"#NOTES:dance-single::Hard:5::\n"
+			"1203\n"
+			"0312\n"
+			"2130\n"
+			";\n";
+
+		chart::song_t *song = new chart::song_t();
+		chart::chart_t chart;
+		VBEAT_CHECK(chart::parse_sm(text, strlen(text), false, *song, &chart, 0));
+		VBEAT_CHECK(chart.rows.size() == 9);
+		VBEAT_CHECK(chart.rows.capacity() == chart.rows.size());
+		delete song;
+	}
+}
+
+void tests::run_sm() {
+	unterminated_last_value();
+	holds_fit_the_reserve();
+}
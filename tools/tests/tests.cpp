@@ -0,0 +1,23 @@
+/* tests: checks for the parts that don't need a window.
+ *
+ *   tests
+ *
+ * Prints what failed, and exits nonzero if anything did. */
+
+#include <cstdlib>
+
+#include "tests.hpp"
+
+int tests::failed = 0;
+
+int main() {
+	tests::run_sm();
+	tests::run_session();
+
+	if (tests::failed > 0) {
+		printf("Tests: %d failed.\n", tests::failed);
+		return EXIT_FAILURE;
+	}
+	printf("Tests: All passed.\n");
+	return EXIT_SUCCESS;
+}
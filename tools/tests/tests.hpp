@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdio>
+
+/* Just enough to check things and say where it went wrong. Each file has a
+ * run_*() that returns how many checks failed. */
+namespace tests {
+	extern int failed;
+}
+
+#define VBEAT_CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("Tests: %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			tests::failed++; \
+		} \
+	} while (0)
+
+namespace tests {
+	void run_sm();
+	void run_session();
+}
@@ -0,0 +1,219 @@
+/* verify: score replays of a chart without a window, for checking submissions.
+ *
+ *   verify [--threads N] [--chart N] [--out results.csv] chart replays...
+ *
+ * Replays can be .vbr files or directories of them, all through the VFS.
+ * Each one goes through a game::session_t, the same judging the notefield
+ * does, tick for tick, so the result is what the player saw. Nothing gets
+ * rendered; there's no SDL window or bgfx at all. Runs across a thread pool
+ * with one session per worker, and writes one CSV line per replay. */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "vbeat.hpp"
+#include "clock.hpp"
+#include "fs.hpp"
+#include "thread_pool.hpp"
+#include "version.hpp"
+#include "chart/binary.hpp"
+#include "game/judge.hpp"
+#include "game/replay.hpp"
+#include "game/session.hpp"
+
+using namespace vbeat;
+
+namespace {
+	// well past anything the game runs at; caps how long one file can take.
+	const uint32_t max_tick_rate = 10000;
+
+	struct status {
+		enum Enum {
+			ok,
+			unreadable,
+			wrong_chart, // different chart hash, or a tick rate nothing plays at
+			wrong_windows,
+			bad_events,  // some events couldn't have come from live input
+			incomplete,  // the recorder lost some
+			count
+		};
+	};
+
+	const char *status_names[status::count] = {
+		"ok",
+		"unreadable",
+		"wrong chart",
+		"wrong windows",
+		"bad events",
+		"incomplete"
+	};
+
+	struct result_t {
+		uint32_t      status; // status::Enum
+		char          build[32];
+		game::stats_t stats;
+		uint32_t      events;
+		uint32_t      rejected; // see session_t::play_back
+		uint32_t      missing;  // lost while recording
+		uint32_t      dropped;  // judgments the judge couldn't hand over
+	};
+
+	struct worker_t {
+		game::session_t session;
+		game::replay_t  replay;
+	};
+
+	bool ends_with(const std::string &s, const char *suffix) {
+		size_t n = strlen(suffix);
+		return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+	}
+
+	void verify(const chart::chart_t &chart, uint64_t hash, const std::string &filename, worker_t &w, result_t &r) {
+		memset(&r, 0, sizeof(r));
+		if (!w.replay.load(filename)) {
+			r.status = status::unreadable;
+			return;
+		}
+
+		const game::replay_header_t &h = w.replay.header;
+		memcpy(r.build, h.build, sizeof(r.build));
+		r.build[sizeof(r.build) - 1] = '\0';
+		r.events  = uint32_t(w.replay.events.size());
+		r.missing = w.replay.missing;
+		if (h.chart != hash || h.tick_rate == 0 || h.tick_rate > max_tick_rate) {
+			r.status = status::wrong_chart;
+			return;
+		}
+		for (int i = 0; i < game::tier::miss; i++) {
+			if (h.windows[i] != game::tier_windows[i]) {
+				r.status = status::wrong_windows;
+				return;
+			}
+		}
+
+		// at the replay's own tick rate; the events are numbered in its ticks.
+		w.session.reset(&chart, h.tick_rate);
+		w.session.play_back(&w.replay);
+		while (!w.session.done()) {
+			w.session.tick();
+		}
+		r.stats    = w.session.stats;
+		r.rejected = w.session.rejected;
+		r.dropped  = w.session.judge.dropped_results();
+		r.status   = r.rejected > 0 ? status::bad_events : status::ok;
+		// scored all the same, but it isn't the whole play.
+		if (r.missing > 0) {
+			r.status = status::incomplete;
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	clock::init();
+
+	uint32_t    threads = 0;
+	int         which   = 0;
+	std::string out     = "results.csv";
+	std::vector<std::string> args;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = uint32_t(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--chart") == 0 && i + 1 < argc) {
+			which = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+			out = argv[++i];
+		} else if (argv[i][0] == '-') {
+			args.clear();
+			break;
+		} else {
+			args.push_back(argv[i]);
+		}
+	}
+	if (args.size() < 2) {
+		printf("usage: %s [--threads N] [--chart N] [--out results.csv] chart replays...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	fs::state vfs(argv[0]);
+
+	uint64_t start = clock::now();
+
+	chart::chart_t chart;
+	if (!chart::load_chart(args[0], chart, which)) {
+		printf("Verify: Couldn't load chart %d of %s.\n", which, args[0].c_str());
+		return EXIT_FAILURE;
+	}
+	uint64_t hash = chart.hash();
+
+	// directories get everything in them that looks like a replay.
+	std::vector<std::string> files;
+	for (size_t i = 1; i < args.size(); i++) {
+		fs::stat_t st;
+		if (!fs::stat(args[i], st)) {
+			printf("Verify: No %s.\n", args[i].c_str());
+			continue;
+		}
+		if (!st.is_dir) {
+			files.push_back(args[i]);
+			continue;
+		}
+		std::vector<std::string> items;
+		fs::get_directory_items(items, args[i]);
+		for (auto &item : items) {
+			if (ends_with(item, ".vbr")) {
+				files.push_back(args[i] + "/" + item);
+			}
+		}
+	}
+
+	thread_pool_t pool;
+	pool.init(threads);
+
+	uint32_t num_workers = pool.size();
+	std::vector<worker_t> workers(num_workers);
+	std::vector<result_t> results(files.size());
+
+	// the chart is only read, and every job has its own result slot.
+	pool.run(uint32_t(files.size()), [&](uint32_t job, uint32_t worker) {
+		verify(chart, hash, files[job], workers[worker], results[job]);
+	});
+	pool.shutdown();
+	workers.clear();
+
+	uint32_t counts[status::count] = {};
+	std::string csv = "file,status,build,perfect,great,good,miss,accuracy,max_combo,mean_ms,ur,events,bad_events,missing,dropped\n";
+	for (size_t i = 0; i < files.size(); i++) {
+		const result_t &r = results[i];
+		counts[r.status] += 1;
+
+		char line[512];
+		const uint32_t *tiers = r.stats.tiers;
+		snprintf(line, sizeof(line), "%s,%s,%s,%u,%u,%u,%u,%.4f,%u,%.2f,%.2f,%u,%u,%u,%u\n",
+			files[i].c_str(), status_names[r.status], r.build,
+			tiers[game::tier::perfect], tiers[game::tier::great],
+			tiers[game::tier::good], tiers[game::tier::miss],
+			r.stats.accuracy, r.stats.max_combo, r.stats.mean, r.stats.unstable_rate,
+			r.events, r.rejected, r.missing, r.dropped
+		);
+		csv += line;
+	}
+
+	double seconds = double(clock::now() - start) / double(clock::frequency());
+	printf("Verify: %u replays on %u threads in %.1fs: %u ok, %u unreadable, %u for another chart, %u with other windows, %u with bad events, %u incomplete.\n",
+		unsigned(files.size()), num_workers, seconds,
+		counts[status::ok], counts[status::unreadable],
+		counts[status::wrong_chart], counts[status::wrong_windows],
+		counts[status::bad_events], counts[status::incomplete]
+	);
+	printf("Verify: Judged by build \"%s\".\n", build_id());
+
+	if (!fs::write(out, csv)) {
+		printf("Verify: Couldn't write %s.\n", out.c_str());
+		return EXIT_FAILURE;
+	}
+	printf("Verify: Wrote %s.\n", out.c_str());
+	return counts[status::ok] == files.size() ? EXIT_SUCCESS : EXIT_FAILURE;
+}